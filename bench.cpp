@@ -0,0 +1,388 @@
+// Headless benchmark: runs the game on a generated level for a fixed number of frames, without a window or GPU, and
+// prints the timings as JSON. With --replay it runs the real levels on an input recording instead, as fast as it can
+// and by default up to the recording's last tick, optionally starting from a snapshot taken during the session.
+//     bench [--frames N] [--size WIDTH HEIGHT] [--enemies N] [--friendlies N] [--patrol-points N] [--seed N]
+//           [--replay RECORDING [--snapshot SNAPSHOT]]
+
+#include "game.hpp"
+#include "gpu_instance.hpp"
+#include "input_manager.hpp"
+#include "input_recording.hpp"
+#include "profiler.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Options
+{
+    // 3000, or up to the end of the replay
+    std::optional<uint32_t> frames;
+    uint32_t width = 256;
+    uint32_t height = 256;
+    uint32_t enemies = 2000;
+    uint32_t friendlies = 2000;
+    uint32_t patrolPoints = 4000;
+    uint32_t seed = 1;
+    std::string replayPath;
+    std::string snapshotPath;
+};
+
+// every texture is resident right away, nothing is drawn
+struct BenchResourceLoader final : eng::ResourceLoaderInterface
+{
+    uint32_t loadTexture(const std::string& filePath) override
+    {
+        return numTextures++;
+    }
+
+    void unloadTexture(const uint32_t textureIndex) override
+    {
+    }
+
+    bool textureResident(const uint32_t textureIndex) override
+    {
+        return true;
+    }
+
+    uint32_t numTextures = 0;
+};
+
+static Options parseOptions(const int argc, const char** argv)
+{
+    Options options;
+    const auto value = [&](int& i)
+        {
+            if (++i >= argc)
+            {
+                throw std::runtime_error(std::string("Missing value for ") + argv[i - 1]);
+            }
+            return static_cast<uint32_t>(std::stoul(argv[i]));
+        };
+    const auto path = [&](int& i)
+        {
+            if (++i >= argc)
+            {
+                throw std::runtime_error(std::string("Missing value for ") + argv[i - 1]);
+            }
+            return std::string(argv[i]);
+        };
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view option = argv[i];
+        if (option == "--frames")
+        {
+            options.frames = value(i);
+        }
+        else if (option == "--size")
+        {
+            options.width = value(i);
+            options.height = value(i);
+        }
+        else if (option == "--enemies")
+        {
+            options.enemies = value(i);
+        }
+        else if (option == "--friendlies")
+        {
+            options.friendlies = value(i);
+        }
+        else if (option == "--patrol-points")
+        {
+            options.patrolPoints = value(i);
+        }
+        else if (option == "--seed")
+        {
+            options.seed = value(i);
+        }
+        else if (option == "--replay")
+        {
+            options.replayPath = path(i);
+        }
+        else if (option == "--snapshot")
+        {
+            options.snapshotPath = path(i);
+        }
+        else
+        {
+            throw std::runtime_error("Unknown option: " + std::string(option));
+        }
+    }
+    if (options.width < 3 || options.height < 3)
+    {
+        throw std::runtime_error("The level needs to be at least 3x3");
+    }
+    if (!options.snapshotPath.empty() && options.replayPath.empty())
+    {
+        throw std::runtime_error("--snapshot needs --replay");
+    }
+    return options;
+}
+
+// A walled level with scattered walls, the player in the middle and the door in the top wall. Enemies, friendlies and
+// patrol points go on random free cells, as many as fit.
+static std::string generateLevel(const Options& options)
+{
+    std::mt19937 random(options.seed);
+    std::vector<std::string> rows(options.height, std::string(options.width, '_'));
+    std::vector<std::pair<uint32_t, uint32_t>> freeCells;
+    for (uint32_t y = 0; y < options.height; ++y)
+    {
+        for (uint32_t x = 0; x < options.width; ++x)
+        {
+            if (x == 0 || y == 0 || x == options.width - 1 || y == options.height - 1 || random() % 10 == 0)
+            {
+                rows[y][x] = 'X';
+            }
+            else
+            {
+                freeCells.push_back({ x, y });
+            }
+        }
+    }
+    rows[0][options.width / 2] = 'D';
+    rows[options.height / 2][options.width / 2] = 'P';
+    std::erase(freeCells, std::pair(options.width / 2, options.height / 2));
+    std::shuffle(freeCells.begin(), freeCells.end(), random);
+
+    auto cell = freeCells.begin();
+    for (const auto& [kind, count] : { std::pair('E', options.enemies), std::pair('F', options.friendlies), std::pair('T', options.patrolPoints) })
+    {
+        for (uint32_t i = 0; i < count && cell != freeCells.end(); ++i, ++cell)
+        {
+            rows[cell->second][cell->first] = kind;
+        }
+    }
+
+    std::string source = "level 0\ntext BENCHMARK\n";
+    for (const auto& row : rows)
+    {
+        source += row;
+        source += '\n';
+    }
+    return source;
+}
+
+struct Percentiles
+{
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+static Percentiles percentiles(std::vector<double> values)
+{
+    Percentiles result;
+    if (values.empty())
+    {
+        return result;
+    }
+    std::sort(values.begin(), values.end());
+    const auto at = [&](const double fraction) { return values[static_cast<size_t>(fraction * (values.size() - 1))]; };
+    for (const double value : values)
+    {
+        result.mean += value / values.size();
+    }
+    result.p50 = at(0.5);
+    result.p90 = at(0.9);
+    result.p99 = at(0.99);
+    result.max = values.back();
+    return result;
+}
+
+static std::vector<std::byte> readFile(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open " + filePath);
+    }
+    std::vector<char> data { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    const auto bytes = std::as_bytes(std::span(data));
+    return { bytes.begin(), bytes.end() };
+}
+
+static void writePercentiles(std::ostream& output, const Percentiles& values)
+{
+    output << "{\"meanMs\":" << values.mean * 1000 << ",\"p50Ms\":" << values.p50 * 1000 << ",\"p90Ms\":" << values.p90 * 1000
+        << ",\"p99Ms\":" << values.p99 * 1000 << ",\"maxMs\":" << values.max * 1000 << '}';
+}
+
+int main(int argc, const char** argv)
+{
+    Options options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << std::endl;
+        std::cerr << "usage: " << argv[0] << " [--frames N] [--size WIDTH HEIGHT] [--enemies N] [--friendlies N] [--patrol-points N] [--seed N]"
+            << " [--replay RECORDING [--snapshot SNAPSHOT]]" << std::endl;
+        return 1;
+    }
+
+    // the game's own scopes end up in here, nothing is written to disk
+    eng::Profiler profiler("");
+
+    GameLogic gameLogic;
+    std::optional<eng::InputRecording> recording;
+    double deltaTime = 1.0 / 60.0;
+    if (options.replayPath.empty())
+    {
+        gameLogic.levels.emplace(level_pack::compile(generateLevel(options)));
+    }
+    else
+    {
+        recording.emplace(options.replayPath);
+        deltaTime = recording->tickInterval;
+        // no window is opened, but the mappings need the scancodes the recording was made with
+        if (!glfwInit())
+        {
+            throw std::runtime_error("Failed to initialize GLFW");
+        }
+    }
+
+    eng::ThreadPool threadPool;
+    eng::Scene scene;
+    scene.threadPool_ = &threadPool;
+    scene.framebufferSize_ = { 2 * GameLogic::texelsPerTile * GameLogic::maxTilesHorizontal, 2 * GameLogic::texelsPerTile * GameLogic::maxTilesVertical };
+    eng::InputManager input;
+    BenchResourceLoader resourceLoader;
+
+    const auto initBegin = std::chrono::steady_clock::now();
+    gameLogic.init(resourceLoader, scene, input);
+    const double initTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - initBegin).count();
+
+    auto record = recording ? recording->records.cbegin() : decltype(recording->records.cbegin()) {};
+    uint32_t frames = options.frames.value_or(3000);
+    if (recording)
+    {
+        if (!options.snapshotPath.empty())
+        {
+            gameLogic.loadSnapshot(readFile(options.snapshotPath));
+        }
+        // the input state the snapshot was taken with
+        for (; record != recording->records.cend() && record->tick < gameLogic.frame; ++record)
+        {
+            input.handleEvent(eng::InputRecording::event(*record));
+        }
+        input.nextFrame();
+        const uint64_t lastTick = recording->records.empty() ? 0 : recording->records.back().tick;
+        frames = options.frames.value_or(lastTick >= gameLogic.frame ? lastTick + 1 - gameLogic.frame : 0);
+    }
+
+    // stands in for the mapped instance buffer, filled the way Renderer::updateFrame fills it
+    std::vector<eng::GpuInstance> instanceBuffer;
+    std::vector<double> frameTimes;
+    std::vector<double> uploadTimes;
+    frameTimes.reserve(frames);
+    uploadTimes.reserve(frames);
+    uint64_t totalInstances = 0;
+    uint64_t totalBytes = 0;
+    uint32_t peakInstances = 0;
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        const auto frameBegin = std::chrono::steady_clock::now();
+        for (; recording && record != recording->records.cend() && record->tick == gameLogic.frame; ++record)
+        {
+            input.handleEvent(eng::InputRecording::event(*record));
+        }
+        gameLogic.runFrame(scene, input, deltaTime);
+        input.nextFrame();
+        const auto uploadBegin = std::chrono::steady_clock::now();
+
+        auto& retained = scene.retainedInstances_;
+        uint32_t numInstances = retained.size();
+        for (const auto& instances : scene.instances_)
+        {
+            numInstances += instances.size();
+        }
+        auto [dirtyBegin, dirtyEnd] = retained.takeDirtyRange();
+        if (numInstances > instanceBuffer.size())
+        {
+            instanceBuffer.resize(numInstances);
+            dirtyBegin = 0;
+            dirtyEnd = retained.size();
+        }
+        uint64_t bytes = 0;
+        if (dirtyBegin < dirtyEnd)
+        {
+            eng::streamInstances(retained.instances.data() + dirtyBegin, dirtyEnd - dirtyBegin, instanceBuffer.data() + dirtyBegin);
+            bytes += (dirtyEnd - dirtyBegin) * sizeof(eng::GpuInstance);
+        }
+        uint32_t offset = retained.size();
+        for (const auto& instances : scene.instances_)
+        {
+            eng::packInstances(instances.data(), instances.size(), instanceBuffer.data() + offset);
+            offset += instances.size();
+            bytes += instances.size() * sizeof(eng::GpuInstance);
+        }
+
+        const auto uploadEnd = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double>(uploadBegin - frameBegin).count());
+        uploadTimes.push_back(std::chrono::duration<double>(uploadEnd - uploadBegin).count());
+        totalInstances += numInstances;
+        totalBytes += bytes;
+        peakInstances = std::max(peakInstances, numInstances);
+    }
+    char stateHash[17];
+    std::snprintf(stateHash, sizeof(stateHash), "%016llx", static_cast<unsigned long long>(snapshot::hash(gameLogic.saveSnapshot())));
+    gameLogic.cleanup();
+    if (recording)
+    {
+        glfwTerminate();
+    }
+
+    double totalUploadTime = 0;
+    for (const double time : uploadTimes)
+    {
+        totalUploadTime += time;
+    }
+
+    auto& output = std::cout;
+    output << "{\"frames\":" << frames
+        << ",\"level\":{\"width\":" << gameLogic.spatialIndex.width << ",\"height\":" << gameLogic.spatialIndex.height;
+    if (recording)
+    {
+        output << ",\"index\":" << gameLogic.currentLevel;
+    }
+    else
+    {
+        output << ",\"seed\":" << options.seed;
+    }
+    output << ",\"entities\":" << gameLogic.registry.versions.size() - gameLogic.registry.freeIndices.size() << '}'
+        << ",\"stateHash\":\"" << stateHash << '"'
+        << ",\"initMs\":" << initTime * 1000
+        << ",\"runFrame\":";
+    writePercentiles(output, percentiles(frameTimes));
+    output << ",\"upload\":{\"time\":";
+    writePercentiles(output, percentiles(uploadTimes));
+    output << ",\"peakInstances\":" << peakInstances
+        << ",\"instancesPerSecond\":" << (totalUploadTime > 0 ? totalInstances / totalUploadTime : 0)
+        << ",\"bytesPerSecond\":" << (totalUploadTime > 0 ? totalBytes / totalUploadTime : 0) << '}'
+        << ",\"scopes\":[";
+    const auto scopes = profiler.scopeStats();
+    for (size_t i = 0; i < scopes.size(); ++i)
+    {
+        output << (i > 0 ? "," : "") << "{\"name\":\"" << scopes[i].name << "\",\"count\":" << scopes[i].count
+            << ",\"totalMs\":" << scopes[i].totalTime * 1000 << ",\"meanMs\":" << scopes[i].totalTime * 1000 / scopes[i].count
+            << ",\"maxMs\":" << scopes[i].maxTime * 1000 << '}';
+    }
+    output << "]}" << std::endl;
+}
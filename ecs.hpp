@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Entity handles pack a slot index in the low bits and the slot's version in the high bits. Destroying an entity bumps
+// the version, so handles kept around after that no longer match anything.
+struct Entity
+{
+    constexpr static uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+    constexpr static uint32_t indexBits = 20;
+    constexpr static uint32_t indexMask = (1u << indexBits) - 1;
+    constexpr static uint32_t versionMask = Invalid >> indexBits;
+
+    static constexpr uint32_t index(const uint32_t entity)
+    {
+        return entity & indexMask;
+    }
+
+    static constexpr uint32_t version(const uint32_t entity)
+    {
+        return entity >> indexBits;
+    }
+
+    static constexpr uint32_t make(const uint32_t index, const uint32_t version)
+    {
+        return (version << indexBits) | index;
+    }
+};
+
+namespace detail
+{
+    // bounds checked in debug builds only, the registry keeps entity and component indices consistent
+    template<typename Container>
+    decltype(auto) element(Container& container, const size_t index)
+    {
+#ifdef NDEBUG
+        return container[index];
+#else
+        return container.at(index);
+#endif
+    }
+}
+
+// Which pools each entity is in, one bit per component type, see Registry::bit.
+struct ComponentMaskTable
+{
+    // by entity index
+    std::vector<uint32_t> masks;
+    // called with the entity's new mask whenever a component is added or removed
+    std::function<void(uint32_t entity, uint32_t mask)> onChanged;
+
+    uint32_t get(const uint32_t entity) const
+    {
+        const uint32_t index = Entity::index(entity);
+        return index < masks.size() ? masks[index] : 0;
+    }
+
+    void set(const uint32_t entity, const uint32_t bit, const bool value)
+    {
+        const uint32_t index = Entity::index(entity);
+        if (masks.size() <= index)
+        {
+            masks.resize(index + 1, 0);
+        }
+        masks[index] = value ? masks[index] | bit : masks[index] & ~bit;
+        if (onChanged)
+        {
+            onChanged(entity, masks[index]);
+        }
+    }
+};
+
+template<typename ComponentType>
+struct ComponentArray
+{
+    std::vector<ComponentType> components;
+    // full handles, parallel to components
+    std::vector<uint32_t> entities;
+    // by entity index
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> toRemove;
+    std::vector<std::pair<uint32_t, ComponentType>> toAdd;
+    ComponentMaskTable* maskTable = nullptr;
+    uint32_t maskBit = 0;
+
+    // the mask table is restored by the registry
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(components, entities, indices, toRemove, toAdd);
+    }
+
+    bool has(uint32_t entity) const
+    {
+        const uint32_t entityIndex = Entity::index(entity);
+        return (indices.size() > entityIndex && indices[entityIndex] < components.size() && entities[indices[entityIndex]] == entity);
+    }
+
+    void remove(uint32_t entity)
+    {
+        uint32_t& index = detail::element(indices, Entity::index(entity));
+        detail::element(components, index) = std::move(components.back());
+        detail::element(entities, index) = entities.back();
+        detail::element(indices, Entity::index(entities[index])) = index;
+        index = std::numeric_limits<uint32_t>::max();
+        components.pop_back();
+        entities.pop_back();
+        if (maskTable)
+        {
+            maskTable->set(entity, maskBit, false);
+        }
+    }
+
+    void clear()
+    {
+        components.clear();
+        entities.clear();
+        indices.clear();
+        toRemove.clear();
+        toAdd.clear();
+    }
+
+    void removeLater(uint32_t id)
+    {
+        toRemove.push_back(id);
+    }
+
+    void addLater(uint32_t id, ComponentType&& component)
+    {
+        toAdd.emplace_back(id, std::move(component));
+    }
+
+    ComponentType& get(uint32_t entity)
+    {
+        return detail::element(components, detail::element(indices, Entity::index(entity)));
+    }
+
+    ComponentType& add(uint32_t entity)
+    {
+        const uint32_t entityIndex = Entity::index(entity);
+        if (indices.size() <= entityIndex)
+        {
+            indices.resize(entityIndex + 1, std::numeric_limits<uint32_t>::max());
+        }
+        indices[entityIndex] = components.size();
+        entities.push_back(entity);
+        auto& component = components.emplace_back();
+        if (maskTable)
+        {
+            maskTable->set(entity, maskBit, true);
+        }
+        return component;
+    }
+
+    template<typename Callable>
+    void forEach(Callable&& fn)
+    {
+        forEachNoFlush(fn);
+        flushRemovals();
+    }
+
+    // Leaves removeLater pending. Flushing writes the shared mask table, so only this is safe while other threads iterate
+    // the registry too.
+    template<typename Callable>
+    void forEachNoFlush(Callable&& fn)
+    {
+        for (uint32_t i = 0; i < components.size(); ++i)
+        {
+            fn(components[i], entities[i]);
+        }
+    }
+
+    void flushRemovals()
+    {
+        for (auto id : toRemove)
+        {
+            // it may have been removed or destroyed since
+            if (has(id))
+            {
+                remove(id);
+            }
+        }
+        toRemove.clear();
+    }
+
+    template<typename AlivePredicate>
+    void flushAdditions(AlivePredicate&& alive)
+    {
+        for (auto& [id, component] : toAdd)
+        {
+            if (!alive(id))
+            {
+                continue;
+            }
+            (has(id) ? get(id) : add(id)) = std::move(component);
+        }
+        toAdd.clear();
+    }
+};
+
+// Every component type is listed up front, so component<T>() resolves to a fixed tuple element at compile time.
+// Asking for a type that isn't registered fails to compile.
+template<typename... ComponentTypes>
+struct Registry
+{
+    static_assert(sizeof...(ComponentTypes) <= 32, "component masks are 32 bit");
+
+    ComponentMaskTable componentMasks;
+    std::tuple<ComponentArray<ComponentTypes>...> componentArrays;
+    // current version of every slot
+    std::vector<uint32_t> versions;
+    std::vector<uint32_t> freeIndices;
+    std::vector<uint32_t> toDestroy;
+
+    Registry()
+    {
+        ((component<ComponentTypes>().maskTable = &componentMasks, component<ComponentTypes>().maskBit = bit<ComponentTypes>()), ...);
+    }
+
+    // the pools point at componentMasks
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    template<typename ComponentType>
+    ComponentArray<ComponentType>& component()
+    {
+        return std::get<ComponentArray<ComponentType>>(componentArrays);
+    }
+
+    template<typename ComponentType>
+    static constexpr uint32_t bit()
+    {
+        constexpr std::array matches { std::is_same_v<ComponentType, ComponentTypes>... };
+        constexpr size_t index = std::find(matches.begin(), matches.end(), true) - matches.begin();
+        static_assert(index < matches.size(), "component type is not registered");
+        return 1u << index;
+    }
+
+    uint32_t componentMask(const uint32_t entity) const
+    {
+        return componentMasks.get(entity);
+    }
+
+    // Reading doesn't call componentMasks.onChanged, whatever it keeps in sync has to be restored alongside.
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(componentMasks.masks, versions, freeIndices, toDestroy);
+        std::apply([&](auto&... componentArray) { archive(componentArray...); }, componentArrays);
+    }
+
+    uint32_t createEntity()
+    {
+        uint32_t index;
+        if (!freeIndices.empty())
+        {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            index = versions.size();
+            // the last index is reserved so no handle can equal Entity::Invalid
+            if (index >= Entity::indexMask)
+            {
+                throw std::runtime_error("Too many entities");
+            }
+            versions.push_back(0);
+        }
+        return Entity::make(index, versions[index]);
+    }
+
+    bool alive(const uint32_t entity) const
+    {
+        const uint32_t index = Entity::index(entity);
+        return entity != Entity::Invalid && index < versions.size() && versions[index] == Entity::version(entity);
+    }
+
+    // Calls fn(components&..., entity) for every entity that has all of the listed components. Walks the smallest pool,
+    // the first listed one on ties, so the order matches that pool's forEach. removeLater is honored like in forEach.
+    template<typename... ViewTypes, typename Callable>
+    void view(Callable&& fn)
+    {
+        viewNoFlush<ViewTypes...>(fn);
+        (component<ViewTypes>().flushRemovals(), ...);
+    }
+
+    // Like view, but leaves removeLater pending, see ComponentArray::forEachNoFlush.
+    template<typename... ViewTypes, typename Callable>
+    void viewNoFlush(Callable&& fn)
+    {
+        static_assert(sizeof...(ViewTypes) > 0);
+        const std::array sizes { component<ViewTypes>().components.size()... };
+        const size_t driver = std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+        size_t i = 0;
+        ((i++ == driver ? viewFrom<ViewTypes, ViewTypes...>(fn) : void()), ...);
+    }
+
+    void destroyEntity(uint32_t entity)
+    {
+        destroyLater(entity);
+        flushDestroys();
+    }
+
+    // Structural changes that are safe to record while iterating, applied together by applyCommands().
+
+    template<typename ComponentType>
+    void addLater(uint32_t entity, ComponentType component = {})
+    {
+        this->component<ComponentType>().addLater(entity, std::move(component));
+    }
+
+    template<typename ComponentType>
+    void removeLater(uint32_t entity)
+    {
+        component<ComponentType>().removeLater(entity);
+    }
+
+    void destroyLater(uint32_t entity)
+    {
+        toDestroy.push_back(entity);
+    }
+
+    // Additions go first, then removals, then destroys, so an entity destroyed in the same batch stays destroyed.
+    void applyCommands()
+    {
+        std::apply([this](auto&... componentArray)
+                {
+                    (componentArray.flushAdditions([this](uint32_t entity) { return alive(entity); }), ...);
+                    (componentArray.flushRemovals(), ...);
+                }, componentArrays);
+        flushDestroys();
+    }
+
+    void clear()
+    {
+        std::apply([](auto&... componentArray) { (componentArray.clear(), ...); }, componentArrays);
+        std::fill(componentMasks.masks.begin(), componentMasks.masks.end(), 0);
+        toDestroy.clear();
+        // old handles stay invalid, and the lowest slots are reused first
+        freeIndices.clear();
+        for (uint32_t index = versions.size(); index-- > 0;)
+        {
+            versions[index] = (versions[index] + 1) & Entity::versionMask;
+            freeIndices.push_back(index);
+        }
+    }
+
+private:
+    template<typename DriverType, typename... ViewTypes, typename Callable>
+    void viewFrom(Callable& fn)
+    {
+        auto& driver = component<DriverType>();
+        for (uint32_t i = 0; i < driver.components.size(); ++i)
+        {
+            const uint32_t entity = driver.entities[i];
+            if ((component<ViewTypes>().has(entity) && ...))
+            {
+                fn(component<ViewTypes>().get(entity)..., entity);
+            }
+        }
+    }
+
+    void flushDestroys()
+    {
+        // retiring the handles first also drops duplicates, each pool is then walked once for the whole batch
+        std::erase_if(toDestroy, [this](const uint32_t entity)
+                {
+                    if (!alive(entity))
+                    {
+                        return true;
+                    }
+                    const uint32_t index = Entity::index(entity);
+                    versions[index] = (versions[index] + 1) & Entity::versionMask;
+                    freeIndices.push_back(index);
+                    return false;
+                });
+
+        std::apply([this](auto&... componentArray)
+                {
+                    ([&]
+                    {
+                        for (const uint32_t entity : toDestroy)
+                        {
+                            if (componentArray.has(entity))
+                            {
+                                componentArray.remove(entity);
+                            }
+                        }
+                    }(), ...);
+                }, componentArrays);
+        toDestroy.clear();
+    }
+};
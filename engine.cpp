@@ -1,15 +1,27 @@
 #include "engine.hpp"
+#include "gpu_timeline.hpp"
 #include "input_manager.hpp"
+#include "instance_store.hpp"
+#include "pipeline_cache.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
+#include "scene.hpp"
+#include "simulation_thread.hpp"
 #include "swapchain.hpp"
 #include "texture_loader.hpp"
+#include "thread_pool.hpp"
 #include "vulkan_includes.hpp"
 
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <optional>
 #include <stdexcept>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include "config.h"
 
@@ -144,14 +156,38 @@ static uint32_t getQueueFamilyIndex(const vk::raii::PhysicalDevice& physicalDevi
     throw std::runtime_error("No suitable queue family found");
 }
 
-static vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDevice, uint32_t queueFamilyIndex, bool& bindlessSupported)
+// Families that support flags but none of graphics or compute, typically backed by a DMA engine.
+static std::optional<uint32_t> getDedicatedQueueFamilyIndex(const vk::raii::PhysicalDevice& physicalDevice, const vk::QueueFlags& flags)
+{
+    auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < queueFamilies.size(); ++i)
+    {
+        if ((queueFamilies[i].queueFlags & flags) && !(queueFamilies[i].queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+        {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+static vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDevice, uint32_t queueFamilyIndex, uint32_t transferQueueFamilyIndex, bool& bindlessSupported, bool& multiDrawIndirectSupported, bool& presentWaitSupported, const bool wantPresentWait)
 {
     const float queuePriority = 1.0f;
-    const vk::DeviceQueueCreateInfo queueCreateInfo {
-        .queueFamilyIndex = queueFamilyIndex,
-        .queueCount = 1,
-        .pQueuePriorities = &queuePriority,
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos = {
+        vk::DeviceQueueCreateInfo {
+            .queueFamilyIndex = queueFamilyIndex,
+            .queueCount = 1,
+            .pQueuePriorities = &queuePriority,
+        },
     };
+    if (transferQueueFamilyIndex != queueFamilyIndex)
+    {
+        queueCreateInfos.push_back(vk::DeviceQueueCreateInfo {
+                .queueFamilyIndex = transferQueueFamilyIndex,
+                .queueCount = 1,
+                .pQueuePriorities = &queuePriority,
+            });
+    }
 
     std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -159,6 +195,8 @@ static vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDev
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
     };
 
+    bool presentIdExtension = false;
+    bool presentWaitExtension = false;
     auto extensionProperties = physicalDevice.enumerateDeviceExtensionProperties();
     for (const auto& properties : extensionProperties)
     {
@@ -166,22 +204,44 @@ static vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDev
         {
             deviceExtensions.push_back(properties.extensionName);
         }
+        presentIdExtension = presentIdExtension || strcmp(properties.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0;
+        presentWaitExtension = presentWaitExtension || strcmp(properties.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0;
+    }
+
+    presentWaitSupported = false;
+    if (wantPresentWait && presentIdExtension && presentWaitExtension)
+    {
+        const auto presentFeaturesChain = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        presentWaitSupported = presentFeaturesChain.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId && presentFeaturesChain.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+    if (presentWaitSupported)
+    {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
     }
 
     const auto physicalDeviceFeaturesChain = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
     const auto& physicalDeviceVulkan12Features = physicalDeviceFeaturesChain.get<vk::PhysicalDeviceVulkan12Features>();
-    bindlessSupported = (physicalDeviceVulkan12Features.shaderSampledImageArrayNonUniformIndexing && physicalDeviceVulkan12Features.runtimeDescriptorArray);
+    bindlessSupported = (physicalDeviceVulkan12Features.shaderSampledImageArrayNonUniformIndexing && physicalDeviceVulkan12Features.runtimeDescriptorArray
+        && physicalDeviceVulkan12Features.descriptorBindingPartiallyBound && physicalDeviceVulkan12Features.descriptorBindingSampledImageUpdateAfterBind);
+    multiDrawIndirectSupported = physicalDeviceFeaturesChain.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect;
 
-    const vk::StructureChain deviceCreateInfoChain {
+    vk::StructureChain deviceCreateInfoChain {
         vk::DeviceCreateInfo {
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &queueCreateInfo,
+            .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
+            .pQueueCreateInfos = queueCreateInfos.data(),
             .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
             .ppEnabledExtensionNames = deviceExtensions.data(),
         },
-        vk::PhysicalDeviceFeatures2 {},
+        vk::PhysicalDeviceFeatures2 {
+            .features = vk::PhysicalDeviceFeatures {
+                .multiDrawIndirect = multiDrawIndirectSupported ? vk::True : vk::False,
+            },
+        },
         vk::PhysicalDeviceVulkan12Features {
             .shaderSampledImageArrayNonUniformIndexing = bindlessSupported ? vk::True : vk::False,
+            .descriptorBindingSampledImageUpdateAfterBind = bindlessSupported ? vk::True : vk::False,
+            .descriptorBindingPartiallyBound = bindlessSupported ? vk::True : vk::False,
             .runtimeDescriptorArray = bindlessSupported ? vk::True : vk::False,
             .timelineSemaphore = vk::True,
         },
@@ -191,7 +251,18 @@ static vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDev
         vk::PhysicalDeviceDynamicRenderingFeatures {
             .dynamicRendering = vk::True,
         },
+        vk::PhysicalDevicePresentIdFeaturesKHR {
+            .presentId = vk::True,
+        },
+        vk::PhysicalDevicePresentWaitFeaturesKHR {
+            .presentWait = vk::True,
+        },
     };
+    if (!presentWaitSupported)
+    {
+        deviceCreateInfoChain.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+        deviceCreateInfoChain.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+    }
 
     return vk::raii::Device(physicalDevice, deviceCreateInfoChain.get<vk::DeviceCreateInfo>());
 }
@@ -221,89 +292,89 @@ static vk::SurfaceFormatKHR getSurfaceFormat(const vk::raii::PhysicalDevice& phy
 struct ResourceLoader final : ResourceLoaderInterface
 {
     TextureLoader& textureLoader;
-    std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures;
 
-    explicit ResourceLoader(TextureLoader& textureLoader, std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures) :
-        textureLoader(textureLoader),
-        textures(textures)
+    explicit ResourceLoader(TextureLoader& textureLoader) :
+        textureLoader(textureLoader)
     {
     }
 
     uint32_t loadTexture(const std::string& filePath) override
     {
-        uint32_t index = textures.size();
-        textures.push_back(textureLoader.loadTexture(filePath, vk::Format::eR8G8B8A8Srgb, 4, 4));
-        return index;
-    }
-};
-
-struct Scene final : public SceneInterface
-{
-    std::vector<Instance>& instances() override
-    {
-        return instances_;
-    }
-
-    glm::mat4& projection() override
-    {
-        return projection_;
-    }
-
-    glm::vec2& viewportOffset() override
-    {
-        return viewportOffset_;
+        return textureLoader.loadTexture(filePath, vk::Format::eR8G8B8A8Srgb, 4, 4);
     }
 
-    glm::vec2& viewportExtent() override
+    void unloadTexture(const uint32_t textureIndex) override
     {
-        return viewportExtent_;
+        textureLoader.unloadTexture(textureIndex);
     }
 
-    std::pair<uint32_t, uint32_t> framebufferSize() const override
+    bool textureResident(const uint32_t textureIndex) override
     {
-        return framebufferSize_;
+        return textureLoader.resident(textureIndex);
     }
-
-    std::vector<Instance> instances_;
-    glm::mat4 projection_;
-    glm::vec2 viewportOffset_;
-    glm::vec2 viewportExtent_;
-    std::pair<uint32_t, uint32_t> framebufferSize_;
 };
 
 struct AppCallbackData
 {
-    Swapchain& swapchain;
-    Scene& scene;
-    InputManager& inputManager;
+    std::pair<uint32_t, uint32_t>& framebufferSize;
+    InputEventQueue& inputEvents;
 };
 
+static void writeSnapshot(const std::string& path, const std::vector<std::byte>& data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
 static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     auto& callbackData = *static_cast<AppCallbackData*>(glfwGetWindowUserPointer(window));
-    callbackData.inputManager.handleKey(key, scancode, action, mods);
+    callbackData.inputEvents.push(InputEvent {
+            .type = InputEvent::Type::Key,
+            .code = scancode,
+            .value = action != GLFW_RELEASE ? 1.0 : 0.0,
+            .time = std::chrono::steady_clock::now(),
+        });
 }
 
 static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
     auto& callbackData = *static_cast<AppCallbackData*>(glfwGetWindowUserPointer(window));
-    callbackData.inputManager.handleMouseButton(button, action, mods);
+    callbackData.inputEvents.push(InputEvent {
+            .type = InputEvent::Type::MouseButton,
+            .code = button,
+            .value = action != GLFW_RELEASE ? 1.0 : 0.0,
+            .time = std::chrono::steady_clock::now(),
+        });
 }
 
 static void cursorPositionCallback(GLFWwindow* window, double x, double y)
 {
     auto& callbackData = *static_cast<AppCallbackData*>(glfwGetWindowUserPointer(window));
-    callbackData.inputManager.handleCursorPosition(x, y);
+    const auto time = std::chrono::steady_clock::now();
+    callbackData.inputEvents.push(InputEvent {
+            .type = InputEvent::Type::Cursor,
+            .code = static_cast<int>(InputInterface::CursorAxis::X),
+            .value = x,
+            .time = time,
+        });
+    callbackData.inputEvents.push(InputEvent {
+            .type = InputEvent::Type::Cursor,
+            .code = static_cast<int>(InputInterface::CursorAxis::Y),
+            .value = y,
+            .time = time,
+        });
 }
 
 static void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
+    // the swapchain is recreated by the main loop, older frames may still be using its images
     auto& callbackData = *static_cast<AppCallbackData*>(glfwGetWindowUserPointer(window));
-    if (width != callbackData.swapchain.extent.width || height != callbackData.swapchain.extent.height)
-    {
-        callbackData.swapchain.recreate(vk::Extent2D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height) });
-    }
-    callbackData.scene.framebufferSize_ = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+    callbackData.framebufferSize = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
 }
 
 void eng::run(GameLogicInterface& gameLogic, const ApplicationInfo& applicationInfo)
@@ -319,8 +390,12 @@ void eng::run(GameLogicInterface& gameLogic, const ApplicationInfo& applicationI
     const auto physicalDevice = getPhysicalDevice(instance);
     const auto queueFamilyIndex = getQueueFamilyIndex(physicalDevice, vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute);
     bool bindlessSupported;
-    const auto device = createDevice(physicalDevice, queueFamilyIndex, bindlessSupported);
+    bool multiDrawIndirectSupported;
+    bool presentWaitSupported;
+    const auto transferQueueFamilyIndex = getDedicatedQueueFamilyIndex(physicalDevice, vk::QueueFlagBits::eTransfer).value_or(queueFamilyIndex);
+    const auto device = createDevice(physicalDevice, queueFamilyIndex, transferQueueFamilyIndex, bindlessSupported, multiDrawIndirectSupported, presentWaitSupported, applicationInfo.lowLatency);
     const auto queue = device.getQueue(queueFamilyIndex, 0);
+    const auto transferQueue = device.getQueue(transferQueueFamilyIndex, 0);
     const auto allocator = vma::createAllocatorUnique(vma::AllocatorCreateInfo {
             .physicalDevice = *physicalDevice,
             .device = *device,
@@ -338,21 +413,41 @@ void eng::run(GameLogicInterface& gameLogic, const ApplicationInfo& applicationI
     int framebufferWidth, framebufferHeight;
     glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-    Swapchain swapchain(device, physicalDevice, surface, surfaceFormat, vk::Extent2D{ static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) });
+    Swapchain swapchain(device, physicalDevice, surface, surfaceFormat, vk::Extent2D{ static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) }, applicationInfo.presentMode, applicationInfo.swapchainImageCount, presentWaitSupported);
+    // after the swapchain, so retired swapchains go before the surface
+    GpuTimeline timeline(device);
+
+    // without bindless indexing the shaders can only address a handful of texture descriptors
+    const bool packTextures = applicationInfo.packTextures || !bindlessSupported;
+    uint32_t maxTextureArrays = Renderer::maxNonBindlessTextureArrays;
+    if (bindlessSupported)
+    {
+        const auto propertiesChain = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+        const auto& vulkan12Properties = propertiesChain.get<vk::PhysicalDeviceVulkan12Properties>();
+        maxTextureArrays = std::min({ applicationInfo.maxTextureArrays, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages });
+    }
+    ThreadPool threadPool;
+    TextureLoader textureLoader(device, queue, queueFamilyIndex, transferQueue, transferQueueFamilyIndex, *allocator, threadPool, timeline, packTextures ? TextureLoader::PackingMode::ArrayLayers : TextureLoader::PackingMode::None, applicationInfo.generateMipmaps, maxTextureArrays);
 
-    TextureLoader textureLoader(device, queue, queueFamilyIndex, *allocator);
-    std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>> textures;
+    if (!applicationInfo.texturePackPath.empty() && std::filesystem::exists(applicationInfo.texturePackPath))
+    {
+        textureLoader.openTexturePack(applicationInfo.texturePackPath);
+    }
 
-    ResourceLoader resourceLoader(textureLoader, textures);
+    ResourceLoader resourceLoader(textureLoader);
     Scene scene;
     InputManager inputManager;
+    // filled by the window callbacks, drained by whichever thread runs the game logic
+    InputEventQueue inputEvents;
 
-    scene.framebufferSize_ = { static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) };
+    // written by the window callbacks, the thread running game logic gets a copy
+    std::pair<uint32_t, uint32_t> framebufferSize = { static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) };
+    scene.framebufferSize_ = framebufferSize;
+    scene.threadPool_ = &threadPool;
 
     AppCallbackData appCallbackData {
-        .swapchain = swapchain,
-        .scene = scene,
-        .inputManager = inputManager,
+        .framebufferSize = framebufferSize,
+        .inputEvents = inputEvents,
     };
     glfwSetWindowUserPointer(window, &appCallbackData);
     glfwSetKeyCallback(window, keyCallback);
@@ -360,29 +455,119 @@ void eng::run(GameLogicInterface& gameLogic, const ApplicationInfo& applicationI
     glfwSetCursorPosCallback(window, cursorPositionCallback);
     glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-    gameLogic.init(resourceLoader, scene, inputManager);
-    textureLoader.commit();
+    std::optional<Profiler> profiler;
+    float timestampPeriod = 0;
+    if (applicationInfo.profiling)
+    {
+        profiler.emplace(applicationInfo.profileTracePath);
+        if (physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits > 0)
+        {
+            timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+        }
+    }
+
+    {
+        ProfileScope scope("init");
+        gameLogic.init(resourceLoader, scene, inputManager);
+        textureLoader.commit();
+    }
 
-    Renderer renderer(device, queue, queueFamilyIndex, *allocator, textures, 3, surfaceFormat.format);
+    // threads of its own, so recording never queues up behind texture decoding or game jobs
+    std::optional<ThreadPool> recordingThreadPool;
+    if (applicationInfo.parallelCommandRecording)
+    {
+        recordingThreadPool.emplace(std::min(Renderer::numDrawBatches - 1, std::max(std::thread::hardware_concurrency(), 1u)));
+    }
 
-    textureLoader.finalize();
+    PipelineCache pipelineCache(device, physicalDevice, applicationInfo.pipelineCacheDirectory);
+    Renderer renderer(device, queue, queueFamilyIndex, *allocator, textureLoader.textures, std::max(applicationInfo.framesInFlight, 1u), surfaceFormat.format, applicationInfo.initialInstanceCapacity, applicationInfo.gpuCulling && multiDrawIndirectSupported, bindlessSupported, maxTextureArrays, timestampPeriod, recordingThreadPool ? &*recordingThreadPool : nullptr, applicationInfo.instanceLayers, pipelineCache.cache, timeline);
+
+    // with a fixed tick the game logic owns scene on its own thread and renderScene gets the interpolated ticks
+    std::optional<SimulationThread> simulation;
+    Scene renderScene;
+    if (applicationInfo.simulationTickInterval > 0)
+    {
+        simulation.emplace(gameLogic, scene, textureLoader, inputManager, inputEvents, applicationInfo.simulationTickInterval, applicationInfo.inputRecordingPath);
+    }
+    Scene& drawnScene = simulation ? renderScene : scene;
 
     auto lastTime = glfwGetTime();
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        if (applicationInfo.lowLatency)
+        {
+            // leaves one frame queued so the GPU doesn't idle, more than that only delays input
+            swapchain.waitForPresent(swapchain.lastPresentId - 1, 100'000'000);
+        }
+        {
+            ProfileScope scope("pollEvents");
+            if (framebufferSize.first > 0 && framebufferSize.second > 0)
+            {
+                glfwPollEvents();
+            }
+            else
+            {
+                // nothing gets drawn while minimized, the timeout keeps simulation errors and snapshots coming through
+                glfwWaitEventsTimeout(0.1);
+            }
+        }
 
-        auto time = glfwGetTime();
-        gameLogic.runFrame(scene, inputManager, time - lastTime);
-        lastTime = time;
+        std::vector<std::byte> requestedSnapshot;
+        if (simulation)
+        {
+            simulation->publishFramebufferSize(framebufferSize);
+            simulation->updateScene(renderScene, std::chrono::steady_clock::now());
+            requestedSnapshot = simulation->takeRequestedSnapshot();
+        }
+        else
+        {
+            scene.framebufferSize_ = framebufferSize;
+            inputManager.handleEvents(inputEvents, std::chrono::steady_clock::now());
+            auto time = glfwGetTime();
+            {
+                ProfileScope scope("runFrame");
+                gameLogic.runFrame(scene, inputManager, time - lastTime);
+            }
+            inputManager.nextFrame();
+            lastTime = time;
+            requestedSnapshot = gameLogic.takeRequestedSnapshot();
+        }
+        if (!requestedSnapshot.empty())
+        {
+            writeSnapshot(applicationInfo.snapshotPath, requestedSnapshot);
+        }
 
-        renderer.beginFrame();
-        renderer.updateFrame(scene.instances(), scene.projection_);
-        renderer.drawFrame(swapchain, scene.viewportOffset_, scene.viewportExtent_, scene.instances().size());
-        renderer.nextFrame();
-        inputManager.nextFrame();
+        // a minimized window has no surface to draw to
+        if (framebufferSize.first > 0 && framebufferSize.second > 0)
+        {
+            {
+                ProfileScope scope("beginFrame");
+                renderer.beginFrame();
+                // without a simulation thread the scene about to be drawn is from after every unload
+                renderer.updateTextures(textureLoader.textures, textureLoader.update(simulation ? simulation->drawnTextureUnloads() : textureLoader.unloads()));
+                const vk::Extent2D extent { framebufferSize.first, framebufferSize.second };
+                if (swapchain.outOfDate || extent != swapchain.extent)
+                {
+                    swapchain.recreate(extent, timeline);
+                }
+            }
+            {
+                ProfileScope scope("updateFrame");
+                renderer.updateFrame(drawnScene.retainedInstances_, drawnScene.instances_, drawnScene.tileMap_, drawnScene.tileMapVersion_, drawnScene.projection_, drawnScene.retainedInstanceOffset_);
+            }
+            {
+                ProfileScope scope("drawFrame");
+                renderer.drawFrame(swapchain, drawnScene.viewportOffset_, drawnScene.viewportExtent_);
+            }
+            if (profiler)
+            {
+                profiler->endFrame(renderer.frameStats);
+            }
+            renderer.nextFrame();
+        }
     }
 
+    simulation.reset();
     gameLogic.cleanup();
 
     queue.waitIdle();
@@ -1,12 +1,60 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
 #include <string>
 #include <vector>
 
 namespace eng
 {
+    // Entries of the renderer's sampler table.
+    enum class Sampler : uint32_t
+    {
+        // for pixel art, crisp when magnified
+        Nearest,
+        // trilinear, for scaled UI and text
+        Linear,
+    };
+
+    enum class BlendMode : uint32_t
+    {
+        // blending off, for layers without translucent texels
+        Opaque,
+        Alpha,
+    };
+
+    enum class InstanceOrder
+    {
+        // as added
+        Submission,
+        // grouped by texture, in submission order within a texture, for layers where overlap order doesn't matter
+        Texture,
+    };
+
+    enum class PresentMode
+    {
+        // vsync, never tears
+        Fifo,
+        // vsync, but late frames are shown right away and may tear, falls back to Fifo
+        FifoRelaxed,
+        // vsync without blocking, newer frames replace queued ones, falls back to Fifo
+        Mailbox,
+        // no vsync, tears, falls back to Mailbox and then Fifo
+        Immediate,
+    };
+
+    // How one immediate instance layer is drawn, see SceneInterface::instances.
+    struct InstanceLayerInfo
+    {
+        BlendMode blendMode = BlendMode::Alpha;
+        InstanceOrder order = InstanceOrder::Submission;
+    };
+
     struct Instance
     {
         glm::vec2 position = { 0, 0 };
@@ -16,20 +64,58 @@ namespace eng
         float angle = 0.0f;
         uint32_t textureIndex = 0;
         glm::vec4 tintColor = { 1, 1, 1, 1 };
+        Sampler sampler = Sampler::Nearest;
+    };
+
+    // A grid of 1x1 tiles drawn with a single quad. Row 0 is the top row.
+    struct TileMap
+    {
+        static constexpr uint32_t Empty = std::numeric_limits<uint32_t>::max();
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        glm::vec2 position = { 0, 0 };
+        uint32_t backgroundTextureIndex = Empty;
+        std::vector<uint32_t> tiles;
     };
 
+    // Textures loaded in init can be drawn right away. Later loads are decoded and uploaded in the background, their
+    // index can only be drawn with once textureResident returns true. Safe to keep and use from runFrame, also with
+    // a simulation thread.
     struct ResourceLoaderInterface
     {
         virtual uint32_t loadTexture(const std::string& filePath) = 0;
+        // the index must not be drawn with anymore
+        virtual void unloadTexture(const uint32_t textureIndex) = 0;
+        virtual bool textureResident(const uint32_t textureIndex) = 0;
     };
 
     struct SceneInterface
     {
-        virtual std::vector<Instance>& instances() = 0;
+        // Immediate instances are drawn layer by layer, in the order they were added within a layer. Separate layers can
+        // be filled from separate threads.
+        static constexpr uint32_t numInstanceLayers = 4;
+        using InstanceLayers = std::array<std::vector<Instance>, numInstanceLayers>;
+        using InstanceKeyLayers = std::array<std::vector<uint32_t>, numInstanceLayers>;
+
+        virtual std::vector<Instance>& instances(const uint32_t layer = 0) = 0;
+        // Parallel to instances(layer), what each instance belongs to, like its entity, filled and cleared along with
+        // the instances. With a simulation thread a layer is only eased between two ticks that have the same keys in
+        // the same order, layers left without keys are never eased.
+        virtual std::vector<uint32_t>& instanceKeys(const uint32_t layer = 0) = 0;
+        virtual uint32_t createInstance(const Instance& instance) = 0;
+        virtual void updateInstance(const uint32_t handle, const Instance& instance) = 0;
+        virtual void destroyInstance(const uint32_t handle) = 0;
+        virtual void setTileMap(TileMap&& tileMap) = 0;
+        // applied to retained instances and the tile map
+        virtual glm::vec2& retainedInstanceOffset() = 0;
         virtual glm::mat4& projection() = 0;
         virtual glm::vec2& viewportOffset() = 0;
         virtual glm::vec2& viewportExtent() = 0;
         virtual std::pair<uint32_t, uint32_t> framebufferSize() const = 0;
+        // Runs the jobs concurrently on the engine's worker threads and the calling thread and returns once all of them
+        // finished, rethrowing the first exception. Jobs must not call this themselves.
+        virtual void runInParallel(std::initializer_list<std::function<void()>> jobs) = 0;
     };
 
     struct InputInterface
@@ -70,6 +156,9 @@ namespace eng
         virtual void init(ResourceLoaderInterface& resourceLoader, SceneInterface& scene, InputInterface& input) = 0;
         virtual void runFrame(SceneInterface& scene, InputInterface& input, const double deltaTime) = 0;
         virtual void cleanup() = 0;
+        // Called after every runFrame, on the same thread. A snapshot the game asked for during it, empty if none,
+        // which the engine writes to ApplicationInfo::snapshotPath off the simulation tick.
+        virtual std::vector<std::byte> takeRequestedSnapshot() { return {}; }
     };
 
     struct ApplicationInfo
@@ -79,6 +168,39 @@ namespace eng
         std::string windowTitle;
         uint32_t windowWidth;
         uint32_t windowHeight;
+        uint32_t initialInstanceCapacity = 4096;
+        bool gpuCulling = true;
+        // records the tile map and each instance layer into secondary command buffers on threads of their own
+        bool parallelCommandRecording = true;
+        // pack same sized textures into array layers, always on when bindless indexing isn't supported
+        bool packTextures = true;
+        bool generateMipmaps = true;
+        // prebuilt by the texpack tool, textures missing from it are decoded from their files
+        std::string texturePackPath = "textures/textures.pack";
+        // descriptor slots for texture array images, clamped to the device limits, always 8 without bindless indexing
+        uint32_t maxTextureArrays = 1024;
+        // When set, runFrame is called with this fixed delta time on a thread of its own and frames show the
+        // interpolated last two ticks. Mappings then have to be created in init.
+        double simulationTickInterval = 0;
+        std::array<InstanceLayerInfo, SceneInterface::numInstanceLayers> instanceLayers;
+        // compiled pipelines are kept here between runs, empty to disable
+        std::string pipelineCacheDirectory = ".";
+        PresentMode presentMode = PresentMode::Fifo;
+        // clamped to what the surface supports
+        uint32_t swapchainImageCount = 4;
+        uint32_t framesInFlight = 3;
+        // Waits until the frame before the last one is on screen before input is polled, so at most one frame is
+        // queued for presentation. Needs VK_KHR_present_wait, ignored without it.
+        bool lowLatency = false;
+        // records ProfileScopes, frame stats and GPU time, see Profiler
+        bool profiling = false;
+        // the Chrome trace written on exit while profiling, empty to only collect stats
+        std::string profileTracePath = "profile.json";
+        // Records the input each simulation tick consumed, for replaying the session with the same ticks, see
+        // InputRecording. Needs a simulation thread, empty to not record.
+        std::string inputRecordingPath;
+        // where snapshots from GameLogicInterface::takeRequestedSnapshot go
+        std::string snapshotPath = "snapshot.bin";
     };
 
     void run(GameLogicInterface& gameLogic, const ApplicationInfo& applicationInfo);
@@ -0,0 +1,1585 @@
+#pragma once
+
+#include "ecs.hpp"
+#include "engine.hpp"
+#include "level_pack.hpp"
+#include "profiler.hpp"
+#include "ray_distance_field.hpp"
+#include "ring_buffer.hpp"
+#include "snapshot.hpp"
+#include "spatial_index.hpp"
+#include "text_run.hpp"
+
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <stdexcept>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+enum class Direction
+{
+    Up, Left, Down, Right,
+};
+
+struct MapCoords
+{
+    uint32_t x = std::numeric_limits<uint32_t>::max();
+    uint32_t y = std::numeric_limits<uint32_t>::max();
+};
+
+struct Sprite
+{
+    uint32_t textureIndex;
+    glm::vec4 color { 1, 1, 1, 1 };
+    bool flipHorizontal = false;
+    Direction direction = Direction::Down;
+    uint32_t x = std::numeric_limits<uint32_t>::max();
+    uint32_t y = std::numeric_limits<uint32_t>::max();
+    uint32_t prevx = std::numeric_limits<uint32_t>::max();
+    uint32_t prevy = std::numeric_limits<uint32_t>::max();
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(textureIndex, color, flipHorizontal, direction, x, y, prevx, prevy);
+    }
+};
+
+struct Cell
+{
+    uint32_t x, y;
+    bool solid = false;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(x, y, solid);
+    }
+};
+
+struct CharacterTextureSet
+{
+    std::vector<uint32_t> front;
+    std::vector<uint32_t> back;
+    std::vector<uint32_t> side;
+};
+
+struct CharacterAnimator
+{
+    const CharacterTextureSet* textureSet = nullptr;
+    Direction direction = Direction::Down;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive.pointer(textureSet);
+        archive(direction);
+    }
+};
+
+struct SequenceAnimator
+{
+    const std::vector<uint32_t>* sequence = nullptr;
+    uint32_t frame = 0;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive.pointer(sequence);
+        archive(frame);
+    }
+};
+
+struct Enemy
+{
+    enum class State
+    {
+        Patrolling,
+        Alert,
+        Aggressive,
+        Attack,
+    };
+
+    struct { uint32_t x = std::numeric_limits<uint32_t>::max(), y = std::numeric_limits<uint32_t>::max(); } target;
+    Direction facingDirection = Direction::Down;
+    State state = State::Patrolling;
+    State prevState = State::Patrolling;
+    uint32_t lineFrame = 0;
+};
+
+struct Friendly {};
+
+struct Neutral
+{
+    bool wasFriendly;
+    uint32_t cooldown = 3;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(wasFriendly, cooldown);
+    }
+};
+
+struct PatrolPoint {};
+
+struct Solid {};
+
+struct InputEvent
+{
+    Direction direction;
+};
+
+struct InputIcon
+{
+    bool completed = false;
+};
+
+using Text = eng::TextRun;
+
+struct Door
+{
+    bool open;
+};
+
+struct Transient {};
+
+static constexpr std::pair<int, int> directionCoords(Direction direction)
+{
+    switch (direction)
+    {
+        case Direction::Up:
+            return { 0, -1 };
+        case Direction::Left:
+            return { -1, 0 };
+        case Direction::Down:
+            return { 0, 1 };
+        case Direction::Right:
+            return { 1, 0 };
+        default:
+            return { 0, 0 };
+    }
+}
+
+static constexpr Direction directionFromDelta(int dx, int dy)
+{
+    if (dy < 0)
+    {
+        return Direction::Up;
+    }
+    if (dx < 0)
+    {
+        return Direction::Left;
+    }
+    if (dx > 0)
+    {
+        return Direction::Right;
+    }
+    return Direction::Down;
+}
+
+static constexpr float directionAngle(Direction direction)
+{
+    switch (direction)
+    {
+        case Direction::Up:
+            return glm::pi<float>();
+        case Direction::Left:
+            return -glm::half_pi<float>();
+        case Direction::Down:
+            return 0;
+        case Direction::Right:
+            return glm::half_pi<float>();
+        default:
+            return 0;
+    }
+}
+
+struct GameLogic final : eng::GameLogicInterface
+{
+    std::optional<LevelPack> levels;
+    uint32_t currentLevel = 0;
+
+    struct
+    {
+        uint32_t blank;
+        CharacterTextureSet enemy;
+        CharacterTextureSet friendly;
+        CharacterTextureSet leader;
+        std::vector<uint32_t> sightline;
+        std::vector<uint32_t> sightlineEnd;
+        std::vector<uint32_t> zap;
+        std::vector<uint32_t> zapHit;
+        std::vector<uint32_t> bonk;
+        std::vector<uint32_t> enemySleepy;
+        std::vector<uint32_t> friendlySleepy;
+        std::vector<uint32_t> transform;
+        uint32_t arrow;
+        uint32_t font;
+        uint32_t wall;
+        uint32_t floor;
+        uint32_t doorClosed;
+        uint32_t doorOpen;
+    } textures;
+
+    std::map<Direction, uint32_t> directionInputMappings;
+    uint32_t profilerOverlayMapping;
+    bool profilerOverlay = false;
+    uint32_t snapshotMapping;
+    bool snapshotRequested = false;
+
+    Registry<
+        MapCoords,
+        Sprite,
+        CharacterAnimator,
+        SequenceAnimator,
+        Enemy,
+        Friendly,
+        Neutral,
+        PatrolPoint,
+        Solid,
+        InputIcon,
+        Text,
+        Door,
+        Transient> registry;
+
+    // Per level state is reset in place, the pools, cells and queues keep their capacity for the next level
+    uint32_t mapWidth = 0;
+    uint32_t mapHeight = 0;
+    // by y * mapWidth + x
+    std::vector<Cell> cells;
+    SpatialIndex spatialIndex;
+    RayDistanceField rayDistances;
+    std::vector<uint32_t> playerEntities;
+
+    uint32_t entitiesNeeded;
+
+    static constexpr int animationFramesPerTick = 6;
+    static constexpr int tweenFramesPerTick = 12;
+    static constexpr double tickInterval = 0.5;
+    static constexpr double animationFrameInterval = tickInterval / animationFramesPerTick;
+    static constexpr double tweenFrameInterval = tickInterval / tweenFramesPerTick;
+    double tickTimer = 0;
+    double animationFrameTimer = 0;
+    double tweenFrameTimer = 0;
+    int tweenFrame = 0;
+    float tween = 0;
+
+    glm::vec2 mapViewCenter;
+    glm::vec2 prevMapViewCenter;
+
+    static constexpr int maxTilesVertical = 12;
+    static constexpr int maxTilesHorizontal = 20;
+    static constexpr int texelsPerTile = 32;
+
+    RingBuffer<InputEvent> inputQueue;
+    RingBuffer<uint32_t> inputSpriteEntities;
+
+    uint32_t gubgubCounterText;
+    eng::TextRunCache textRuns;
+
+    bool tileMapDirty = false;
+
+    // runFrame calls so far, which is the simulation tick the next one runs as
+    uint64_t frame = 0;
+
+    static constexpr uint32_t snapshotMagic = 0x50414e53; // "SNAP"
+    static constexpr uint32_t snapshotVersion = 2;
+
+    // scene instance layers, drawn in this order
+    enum InstanceLayer : uint32_t
+    {
+        SpriteLayer,
+        SightlineLayer,
+        TextLayer,
+    };
+
+    template<typename ComponentType>
+    ComponentArray<ComponentType>& component()
+    {
+        return registry.component<ComponentType>();
+    }
+
+    template<typename ComponentType>
+    static constexpr uint32_t bit()
+    {
+        return decltype(registry)::bit<ComponentType>();
+    }
+
+    const Cell& cellAt(const uint32_t x, const uint32_t y) const
+    {
+        return cells[y * mapWidth + x];
+    }
+
+    uint32_t cellMask(const Cell& cell) const
+    {
+        return spatialIndex.mask(cell.x, cell.y);
+    }
+
+    uint32_t findOccupant(const Cell& cell, const uint32_t mask) const
+    {
+        return spatialIndex.findOccupant(cell.x, cell.y, mask);
+    }
+
+    template<typename... ComponentTypes, typename Callable>
+    void view(Callable&& fn)
+    {
+        registry.view<ComponentTypes...>(std::forward<Callable>(fn));
+    }
+
+    template<typename... ComponentTypes, typename Callable>
+    void viewNoFlush(Callable&& fn)
+    {
+        registry.viewNoFlush<ComponentTypes...>(std::forward<Callable>(fn));
+    }
+
+    uint32_t createEntity()
+    {
+        return registry.createEntity();
+    }
+
+    void destroyLater(uint32_t id)
+    {
+        registry.destroyLater(id);
+    }
+
+    void applyCommands()
+    {
+        // destroyed entities lose their MapCoords, which takes them out of spatialIndex
+        registry.applyCommands();
+    }
+
+    void initPlayer(const std::initializer_list<std::pair<uint32_t, uint32_t>>& positions)
+    {
+        playerEntities.reserve(positions.size());
+        auto it = positions.begin();
+        if (it != positions.end())
+        {
+            auto&& [x, y] = *it;
+            uint32_t entity = createEntity();
+            playerEntities.push_back(entity);
+            component<MapCoords>().add(entity);
+            component<Friendly>().add(entity);
+            component<Sprite>().add(entity);
+            component<Solid>().add(entity);
+            component<CharacterAnimator>().add(entity) = {
+                .textureSet = &textures.leader,
+            };
+            component<SequenceAnimator>().add(entity);
+            moveEntity(entity, x, y);
+            ++it;
+        }
+        for (; it != positions.end(); ++it)
+        {
+            auto&& [x, y] = *it;
+            uint32_t entity = createEntity();
+            playerEntities.push_back(entity);
+            component<MapCoords>().add(entity);
+            component<Friendly>().add(entity);
+            component<Sprite>().add(entity);
+            component<Solid>().add(entity);
+            component<CharacterAnimator>().add(entity) = {
+                .textureSet = &textures.friendly,
+            };
+            component<SequenceAnimator>().add(entity);
+            moveEntity(entity, x, y);
+        }
+    }
+
+    void createEnemy(uint32_t x, uint32_t y, Direction facingDirection)
+    {
+        uint32_t entity = createEntity();
+        component<MapCoords>().add(entity);
+        component<Enemy>().add(entity) = { .facingDirection = facingDirection };
+        component<Sprite>().add(entity);
+        component<Solid>().add(entity);
+        component<CharacterAnimator>().add(entity) = {
+            .textureSet = &textures.enemy,
+        };
+        component<SequenceAnimator>().add(entity);
+        moveEntity(entity, x, y);
+    }
+
+    void createFriendly(uint32_t x, uint32_t y, Direction facingDirection)
+    {
+        uint32_t entity = createEntity();
+        component<MapCoords>().add(entity);
+        component<Friendly>().add(entity);
+        component<Sprite>().add(entity);
+        component<Solid>().add(entity);
+        component<CharacterAnimator>().add(entity) = {
+            .textureSet = &textures.friendly,
+        };
+        component<SequenceAnimator>().add(entity);
+        moveEntity(entity, x, y);
+    }
+
+    void clampDeltaToMap(uint32_t x, uint32_t y, int& dx, int& dy)
+    {
+        if (dx < 0 && x == 0)
+        {
+            dx = 0;
+        }
+        if (dx > 0 && x == mapWidth - 1)
+        {
+            dx = 0;
+        }
+        if (dy < 0 && y == 0)
+        {
+            dy = 0;
+        }
+        if (dy > 0 && y == mapHeight - 1)
+        {
+            dy = 0;
+        }
+    }
+
+    void moveEntity(uint32_t id, uint32_t x, uint32_t y)
+    {
+        auto& mapCoords = component<MapCoords>().get(id);
+        if ((mapCoords.x != x || mapCoords.y != y) && x < mapWidth && y < mapHeight)
+        {
+            spatialIndex.insert(id, x, y);
+            mapCoords.x = x, mapCoords.y = y;
+        }
+    }
+
+    // cells a straight scan visits until a wall or the map edge, or up to and including the first cell with a solid occupant
+    uint32_t scanDistance(uint32_t x, uint32_t y, Direction direction) const
+    {
+        return rayDistances.distance(x, y, static_cast<uint32_t>(direction));
+    }
+
+    // the cell a scan ends in if it is stopped by a solid occupant
+    const Cell* scanStop(uint32_t x, uint32_t y, Direction direction) const
+    {
+        if (!rayDistances.endsAtStop(x, y, static_cast<uint32_t>(direction)))
+        {
+            return nullptr;
+        }
+        const uint32_t distance = scanDistance(x, y, direction);
+        const auto [dx, dy] = directionCoords(direction);
+        return &cellAt(x + distance * dx, y + distance * dy);
+    }
+
+    template<typename Callable>
+    bool scan(uint32_t x, uint32_t y, Direction direction, uint32_t limit, Callable&& fn)
+    {
+        const auto [dx, dy] = directionCoords(direction);
+        uint32_t distance = scanDistance(x, y, direction);
+        if (limit != 0)
+        {
+            distance = std::min(distance, limit);
+        }
+        for (uint32_t i = 1; i <= distance; ++i)
+        {
+            if (fn(cellAt(x + i * dx, y + i * dy), i))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void enemyLogic(Enemy& enemy, uint32_t id)
+    {
+        const auto& mapCoords = component<MapCoords>().get(id);
+        enemy.prevState = enemy.state;
+
+        // scan for player, friendlies are always solid so only the cell the sightline ends in can have one
+        const Cell* stop = scanStop(mapCoords.x, mapCoords.y, enemy.facingDirection);
+        if (uint32_t target = stop ? findOccupant(*stop, bit<Friendly>()) : Entity::Invalid; target != Entity::Invalid)
+        {
+            // found player
+            if (enemy.state == Enemy::State::Attack)
+            {
+                enemy.state = Enemy::State::Alert;
+            }
+            else
+            {
+                enemy.state = static_cast<Enemy::State>(static_cast<int>(enemy.state) + 1);
+            }
+
+            if (enemy.state == Enemy::State::Attack)
+            {
+                if (auto it = std::find(playerEntities.begin(), playerEntities.end(), target); it != playerEntities.end())
+                {
+                    if (it == playerEntities.begin())
+                    {
+                        // dead?
+                        ++it;
+                    }
+                    // else
+                    {
+                        for (auto tmp = it; tmp != playerEntities.end(); ++tmp)
+                        {
+                            component<Friendly>().remove(*tmp);
+                            component<Neutral>().add(*tmp).wasFriendly = true;
+                            component<CharacterAnimator>().remove(*tmp);
+                            component<SequenceAnimator>().get(*tmp).sequence = &textures.friendlySleepy;
+                        }
+                        playerEntities.erase(it, playerEntities.end());
+                    }
+                }
+                else
+                {
+                    component<Friendly>().remove(target);
+                    component<Neutral>().add(target).wasFriendly = true;
+                    component<CharacterAnimator>().remove(target);
+                    component<SequenceAnimator>().get(target).sequence = &textures.friendlySleepy;
+                }
+            }
+        }
+        else
+        {
+            // not found player
+            if (enemy.state == Enemy::State::Aggressive)
+            {
+                enemy.state = Enemy::State::Alert;
+            }
+            else
+            {
+                enemy.state = Enemy::State::Patrolling;
+                bool validTarget = enemy.target.x < mapWidth && enemy.target.y < mapHeight;
+                if (validTarget)
+                {
+                    int toTargetX = (int)enemy.target.x - (int)mapCoords.x;
+                    int toTargetY = (int)enemy.target.y - (int)mapCoords.y;
+                    // did we reach it?
+                    if (toTargetX == 0 && toTargetY == 0)
+                    {
+                        validTarget = false;
+                    }
+                    else
+                    {
+                        // are we facing correct direction?
+                        auto [dx, dy] = directionCoords(enemy.facingDirection);
+                        if (dx != glm::sign(toTargetX) || dy != glm::sign(toTargetY))
+                        {
+                            validTarget = false;
+                        }
+                        else
+                        {
+                            // are we about to run into a wall?
+                            clampDeltaToMap(mapCoords.x, mapCoords.y, dx, dy);
+                            uint32_t testx = mapCoords.x + dx, testy = mapCoords.y + dy;
+                            const auto& cell = cellAt(testx, testy);
+                            if (cell.solid || (cellMask(cell) & bit<Solid>()))
+                            {
+                                validTarget = false;
+                            }
+                        }
+                    }
+                }
+
+                bool shouldMoveForward = true;
+                if (!validTarget)
+                {
+                    // scan in current direction, then each of the perpendicular directions
+                    const std::array scanDirections {
+                        enemy.facingDirection, 
+                        static_cast<Direction>((static_cast<int>(enemy.facingDirection) + 1) % 4),
+                        static_cast<Direction>((static_cast<int>(enemy.facingDirection) + 3) % 4),
+                    };
+
+                    uint32_t bestPriority = 0;
+                    uint32_t bestDistance = 0;
+                    int bestIndex = 0;
+
+                    for (uint32_t i = 0; i < scanDirections.size(); ++i)
+                    {
+                        scan(mapCoords.x, mapCoords.y, scanDirections[i], 0,
+                            [&](const Cell& cell, uint32_t distance)
+                            {
+                                uint32_t priority = 0;
+                                bool blocked = false;
+                                // the first solid occupant decides, a patrol point only counts if nothing obstructs it
+                                if (const auto solid = findOccupant(cell, bit<Solid>()); solid != Entity::Invalid)
+                                {
+                                    if (spatialIndex.occupantMask(solid) & bit<Friendly>())
+                                    {
+                                        priority = 2;
+                                    }
+                                    else
+                                    {
+                                        blocked = true;
+                                    }
+                                }
+                                else if (cellMask(cell) & bit<PatrolPoint>())
+                                {
+                                    priority = 1;
+                                }
+                                if (priority > bestPriority || (priority > 0 && priority == bestPriority && distance < bestDistance))
+                                {
+                                    bestPriority = priority;
+                                    bestDistance = distance;
+                                    bestIndex = i;
+                                }
+                                else if (bestPriority == 0 && !blocked && distance > bestDistance)
+                                {
+                                    bestDistance = distance;
+                                    bestIndex = i;
+                                }
+                                return false;
+                            });
+                    }
+
+                    shouldMoveForward = (bestDistance > 0 && scanDirections[bestIndex] == enemy.facingDirection);
+                    enemy.facingDirection = scanDirections[bestIndex];
+                    auto [dx, dy] = directionCoords(enemy.facingDirection);
+                    enemy.target = { mapCoords.x + bestDistance * dx, mapCoords.y + bestDistance * dy };
+                }
+
+                if (shouldMoveForward)
+                {
+                    auto [dx, dy] = directionCoords(enemy.facingDirection);
+                    clampDeltaToMap(mapCoords.x, mapCoords.y, dx, dy);
+                    moveEntity(id, mapCoords.x + dx, mapCoords.y + dy);
+                }
+            }
+        }
+        if (enemy.prevState != enemy.state)
+        {
+            enemy.lineFrame = 0;
+        }
+        component<CharacterAnimator>().get(id).direction = enemy.facingDirection;
+    }
+
+    void loadEnemyTextures(eng::ResourceLoaderInterface& resourceLoader)
+    {
+        uint32_t backDown1 = resourceLoader.loadTexture("textures/NNBackDown1.png");
+        uint32_t backDown2 = resourceLoader.loadTexture("textures/NNBackDown2.png");
+        uint32_t backUp1 = resourceLoader.loadTexture("textures/NNBackUp1.png");
+        uint32_t backUp2 = resourceLoader.loadTexture("textures/NNBackUp2.png");
+        uint32_t frontDown1 = resourceLoader.loadTexture("textures/NNFrontDown1.png");
+        uint32_t frontDown2 = resourceLoader.loadTexture("textures/NNFrontDown2.png");
+        uint32_t frontUp1 = resourceLoader.loadTexture("textures/NNFrontUp1.png");
+        uint32_t frontUp2 = resourceLoader.loadTexture("textures/NNFrontUp2.png");
+        uint32_t frontUp2Blink = resourceLoader.loadTexture("textures/NNFrontUp2Blink.png");
+        uint32_t sideDown1 = resourceLoader.loadTexture("textures/NNSideDown1.png");
+        uint32_t sideDown2 = resourceLoader.loadTexture("textures/NNSideDown2.png");
+        uint32_t sideUp1 = resourceLoader.loadTexture("textures/NNSideUp1.png");
+        uint32_t sideUp2 = resourceLoader.loadTexture("textures/NNSideUp2.png");
+        uint32_t sideUp2Blink = resourceLoader.loadTexture("textures/NNSideUp2Blink.png");
+
+        textures.enemy = {
+            .front = {
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2,
+                frontUp2,
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2Blink,
+                frontUp2,
+            },
+            .back = {
+                backDown1,
+                backDown2,
+                backDown2,
+                backUp1,
+                backUp2,
+                backUp2,
+            },
+            .side = {
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2,
+                sideUp2,
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2Blink,
+                sideUp2,
+            },
+        };
+    }
+
+    void loadFriendlyTextures(eng::ResourceLoaderInterface& resourceLoader)
+    {
+        uint32_t backDown1 = resourceLoader.loadTexture("textures/GGBackDown1.png");
+        uint32_t backDown2 = resourceLoader.loadTexture("textures/GGBackDown2.png");
+        uint32_t backUp1 = resourceLoader.loadTexture("textures/GGBackUp1.png");
+        uint32_t backUp2 = resourceLoader.loadTexture("textures/GGBackUp2.png");
+        uint32_t frontDown1 = resourceLoader.loadTexture("textures/GGFrontDown1.png");
+        uint32_t frontDown2 = resourceLoader.loadTexture("textures/GGFrontDown2.png");
+        uint32_t frontUp1 = resourceLoader.loadTexture("textures/GGFrontUp1.png");
+        uint32_t frontUp2 = resourceLoader.loadTexture("textures/GGFrontUp2.png");
+        uint32_t frontUp2Blink = resourceLoader.loadTexture("textures/GGFrontUp2Blink.png");
+        uint32_t sideDown1 = resourceLoader.loadTexture("textures/GGSideDown1.png");
+        uint32_t sideDown2 = resourceLoader.loadTexture("textures/GGSideDown2.png");
+        uint32_t sideUp1 = resourceLoader.loadTexture("textures/GGSideUp1.png");
+        uint32_t sideUp2 = resourceLoader.loadTexture("textures/GGSideUp2.png");
+        uint32_t sideUp2Blink = resourceLoader.loadTexture("textures/GGSideUp2Blink.png");
+
+        textures.friendly = {
+            .front = {
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2,
+                frontUp2,
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2Blink,
+                frontUp2,
+            },
+            .back = {
+                backDown1,
+                backDown2,
+                backDown2,
+                backUp1,
+                backUp2,
+                backUp2,
+            },
+            .side = {
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2,
+                sideUp2,
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2Blink,
+                sideUp2,
+            },
+        };
+    }
+
+    void loadLeaderTextures(eng::ResourceLoaderInterface& resourceLoader)
+    {
+        uint32_t backDown1 = resourceLoader.loadTexture("textures/BBBackDown1.png");
+        uint32_t backDown2 = resourceLoader.loadTexture("textures/BBBackDown2.png");
+        uint32_t backUp1 = resourceLoader.loadTexture("textures/BBBackUp1.png");
+        uint32_t backUp2 = resourceLoader.loadTexture("textures/BBBackUp2.png");
+        uint32_t frontDown1 = resourceLoader.loadTexture("textures/BBFrontDown1.png");
+        uint32_t frontDown2 = resourceLoader.loadTexture("textures/BBFrontDown2.png");
+        uint32_t frontUp1 = resourceLoader.loadTexture("textures/BBFrontUp1.png");
+        uint32_t frontUp2 = resourceLoader.loadTexture("textures/BBFrontUp2.png");
+        uint32_t frontUp2Blink = resourceLoader.loadTexture("textures/BBFrontUp2Blink.png");
+        uint32_t sideDown1 = resourceLoader.loadTexture("textures/BBSideDown1.png");
+        uint32_t sideDown2 = resourceLoader.loadTexture("textures/BBSideDown2.png");
+        uint32_t sideUp1 = resourceLoader.loadTexture("textures/BBSideUp1.png");
+        uint32_t sideUp2 = resourceLoader.loadTexture("textures/BBSideUp2.png");
+        uint32_t sideUp2Blink = resourceLoader.loadTexture("textures/BBSideUp2Blink.png");
+
+        textures.leader = {
+            .front = {
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2,
+                frontUp2,
+                frontDown1,
+                frontDown2,
+                frontDown2,
+                frontUp1,
+                frontUp2Blink,
+                frontUp2,
+            },
+            .back = {
+                backDown1,
+                backDown2,
+                backDown2,
+                backUp1,
+                backUp2,
+                backUp2,
+            },
+            .side = {
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2,
+                sideUp2,
+                sideDown1,
+                sideDown2,
+                sideDown2,
+                sideUp1,
+                sideUp2Blink,
+                sideUp2,
+            },
+        };
+    }
+
+    void loadLevel(uint32_t index)
+    {
+        const auto& level = levels->level(index);
+        registry.clear();
+        playerEntities.clear();
+        inputQueue.clear();
+        inputSpriteEntities.clear();
+        gubgubCounterText = Entity::Invalid;
+
+        mapWidth = level.width;
+        mapHeight = level.height;
+        cells.resize(mapWidth * mapHeight);
+        spatialIndex.reset(level.width, level.height);
+        rayDistances.reset(level.width, level.height);
+        for (uint32_t row = 0; row < level.height; ++row)
+        {
+            for (uint32_t col = 0; col < level.width; ++col)
+            {
+                const bool solid = levels->solid(level, col, row);
+                cells[row * mapWidth + col] = Cell { .x = col, .y = row, .solid = solid, };
+                rayDistances.setWall(col, row, solid);
+            }
+        }
+        rayDistances.rebuild();
+
+        bool playerPlaced = false;
+        for (const auto& spawn : levels->spawns(level))
+        {
+            const uint32_t x = spawn.x;
+            const uint32_t y = spawn.y;
+            switch (spawn.kind)
+            {
+                case level_pack::Player:
+                    if (!playerPlaced)
+                    {
+                        initPlayer({ {x, y} });
+                        mapViewCenter = { x + 0.5, maxTilesVertical - y - 0.5 };
+                        prevMapViewCenter = mapViewCenter;
+                        playerPlaced = true;
+                    }
+                    break;
+                case level_pack::Enemy:
+                    createEnemy(x, y, Direction::Down);
+                    break;
+                case level_pack::Friendly:
+                    createFriendly(x, y, Direction::Down);
+                    break;
+                case level_pack::PatrolPoint:
+                {
+                    auto id = createEntity();
+                    component<MapCoords>().add(id);
+                    component<PatrolPoint>().add(id);
+                    moveEntity(id, x, y);
+                    break;
+                }
+                case level_pack::Door:
+                {
+                    auto id = createEntity();
+                    component<Door>().add(id);
+                    component<Solid>().add(id);
+                    component<Sprite>().add(id) = {
+                        .textureIndex = textures.doorClosed,
+                    };
+                    component<MapCoords>().add(id);
+                    moveEntity(id, x, y);
+                    break;
+                }
+            }
+        }
+
+        gubgubCounterText = createEntity();
+        component<Text>().add(gubgubCounterText) = Text{
+            .text = "",
+            .position = { 0.5, maxTilesVertical - 0.5 - 0.5 * 0.75 },
+            .scale = { 0.75, 0.75 },
+            .background = { 48.0/255.0, 56.0/255.0, 67.0/255.0, 0.8 },
+            .foreground = { 164.0/255.0, 197.0/255.0, 175.0/255.0, 1 },
+        };
+
+        for (uint32_t i = 0; i < level.numTexts; ++i)
+        {
+            component<Text>().add(createEntity()) = {
+                .text = std::string(levels->text(level, i)),
+                .position = { 1, (level.numTexts - i + 1) * 0.5f - 0.5f * 0.5f },
+                .scale = { 0.5, 0.5 },
+                .background = { 48.0/255.0, 56.0/255.0, 67.0/255.0, 0.8 },
+                .foreground = { 164.0/255.0, 197.0/255.0, 175.0/255.0, 1 },
+            };
+        }
+
+        entitiesNeeded = level.entitiesNeeded;
+        currentLevel = index;
+        tileMapDirty = true;
+
+        view<MapCoords, Sprite>([](const MapCoords& mapCoords, Sprite& sprite, uint32_t id)
+        {
+            sprite.x = mapCoords.x;
+            sprite.y = mapCoords.y;
+        });
+    }
+
+    void init(eng::ResourceLoaderInterface& resourceLoader, eng::SceneInterface& scene, eng::InputInterface& input) override
+    {
+        textures.blank = resourceLoader.loadTexture("textures/blank.png");
+        textures.sightline = {
+            resourceLoader.loadTexture("textures/LOS1.png"),
+            resourceLoader.loadTexture("textures/LOS2.png"),
+            resourceLoader.loadTexture("textures/LOS3.png"),
+            resourceLoader.loadTexture("textures/LOS4.png"),
+            resourceLoader.loadTexture("textures/LOS5.png"),
+            resourceLoader.loadTexture("textures/LOS6.png"),
+        };
+        textures.sightlineEnd = {
+            resourceLoader.loadTexture("textures/LOSHalf1.png"),
+            resourceLoader.loadTexture("textures/LOSHalf2.png"),
+            resourceLoader.loadTexture("textures/LOSHalf3.png"),
+            resourceLoader.loadTexture("textures/LOSHalf4.png"),
+            resourceLoader.loadTexture("textures/LOSHalf5.png"),
+            resourceLoader.loadTexture("textures/LOSHalf6.png"),
+        };
+        textures.zap = {
+            resourceLoader.loadTexture("textures/Zap1.png"),
+            resourceLoader.loadTexture("textures/Zap2.png"),
+            resourceLoader.loadTexture("textures/Zap3.png"),
+            resourceLoader.loadTexture("textures/Zap4.png"),
+            resourceLoader.loadTexture("textures/Zap5.png"),
+            resourceLoader.loadTexture("textures/Zap6.png"),
+        };
+        textures.zapHit = {
+            resourceLoader.loadTexture("textures/ZapHit1.png"),
+            resourceLoader.loadTexture("textures/ZapHit2.png"),
+            resourceLoader.loadTexture("textures/ZapHit3.png"),
+            resourceLoader.loadTexture("textures/ZapHit4.png"),
+            resourceLoader.loadTexture("textures/ZapHit5.png"),
+            resourceLoader.loadTexture("textures/ZapHit6.png"),
+        };
+        textures.bonk = {
+            resourceLoader.loadTexture("textures/Bonk1.png"),
+            resourceLoader.loadTexture("textures/Bonk2.png"),
+            resourceLoader.loadTexture("textures/Bonk3.png"),
+            resourceLoader.loadTexture("textures/Bonk4.png"),
+            resourceLoader.loadTexture("textures/Bonk5.png"),
+            resourceLoader.loadTexture("textures/Bonk6.png"),
+        };
+        textures.enemySleepy = {
+            resourceLoader.loadTexture("textures/NNSleepy1.png"),
+            resourceLoader.loadTexture("textures/NNSleepy2.png"),
+            resourceLoader.loadTexture("textures/NNSleepy3.png"),
+            resourceLoader.loadTexture("textures/NNSleepy4.png"),
+            resourceLoader.loadTexture("textures/NNSleepy5.png"),
+            resourceLoader.loadTexture("textures/NNSleepy6.png"),
+        };
+        textures.friendlySleepy = {
+            resourceLoader.loadTexture("textures/GGSleepy1.png"),
+            resourceLoader.loadTexture("textures/GGSleepy2.png"),
+            resourceLoader.loadTexture("textures/GGSleepy3.png"),
+            resourceLoader.loadTexture("textures/GGSleepy4.png"),
+            resourceLoader.loadTexture("textures/GGSleepy5.png"),
+            resourceLoader.loadTexture("textures/GGSleepy6.png"),
+        };
+        textures.transform = {
+            resourceLoader.loadTexture("textures/Transform1.png"),
+            resourceLoader.loadTexture("textures/Transform2.png"),
+            resourceLoader.loadTexture("textures/Transform3.png"),
+            resourceLoader.loadTexture("textures/Transform4.png"),
+            resourceLoader.loadTexture("textures/Transform5.png"),
+            resourceLoader.loadTexture("textures/Transform6.png"),
+        };
+        textures.arrow = resourceLoader.loadTexture("textures/arrow.png");
+        textures.font = resourceLoader.loadTexture("textures/font.png");
+        textRuns.font = eng::Font {
+            .textureIndex = textures.font,
+            .backgroundTextureIndex = textures.blank,
+        };
+        textures.wall = resourceLoader.loadTexture("textures/WallObstacle.png");
+        textures.floor = resourceLoader.loadTexture("textures/FloorTile.png");
+        textures.doorClosed = resourceLoader.loadTexture("textures/DoorClosed.png");
+        textures.doorOpen = resourceLoader.loadTexture("textures/DoorOpen.png");
+        loadEnemyTextures(resourceLoader);
+        loadFriendlyTextures(resourceLoader);
+        loadLeaderTextures(resourceLoader);
+
+        directionInputMappings[Direction::Up] = input.createMapping();
+        directionInputMappings[Direction::Left] = input.createMapping();
+        directionInputMappings[Direction::Down] = input.createMapping();
+        directionInputMappings[Direction::Right] = input.createMapping();
+
+        input.mapKey(directionInputMappings[Direction::Up], glfwGetKeyScancode(GLFW_KEY_W));
+        input.mapKey(directionInputMappings[Direction::Left], glfwGetKeyScancode(GLFW_KEY_A));
+        input.mapKey(directionInputMappings[Direction::Down], glfwGetKeyScancode(GLFW_KEY_S));
+        input.mapKey(directionInputMappings[Direction::Right], glfwGetKeyScancode(GLFW_KEY_D));
+        profilerOverlayMapping = input.createMapping();
+        input.mapKey(profilerOverlayMapping, glfwGetKeyScancode(GLFW_KEY_F3));
+        snapshotMapping = input.createMapping();
+        input.mapKey(snapshotMapping, glfwGetKeyScancode(GLFW_KEY_F5));
+
+        // may be set up front, the benchmark brings its own levels
+        if (!levels)
+        {
+            levels.emplace("levels/levels.pack", "levels/levels.txt");
+        }
+
+        registry.componentMasks.onChanged = [this](uint32_t entity, uint32_t mask)
+            {
+                spatialIndex.setMask(entity, mask);
+                if (!(mask & bit<MapCoords>()))
+                {
+                    spatialIndex.remove(entity);
+                }
+            };
+        spatialIndex.onCellMaskChanged = [this](uint32_t x, uint32_t y, uint32_t mask)
+            {
+                rayDistances.setStop(x, y, mask & bit<Solid>());
+            };
+
+        loadLevel(0);
+    }
+
+    // everything the snapshot may point into, in a fixed order
+    std::vector<const void*> snapshotPointers() const
+    {
+        std::vector<const void*> pointers;
+        for (const CharacterTextureSet* textureSet : { &textures.enemy, &textures.friendly, &textures.leader })
+        {
+            pointers.insert(pointers.end(), { textureSet, &textureSet->front, &textureSet->back, &textureSet->side });
+        }
+        pointers.insert(pointers.end(), {
+                &textures.sightline,
+                &textures.sightlineEnd,
+                &textures.zap,
+                &textures.zapHit,
+                &textures.bonk,
+                &textures.enemySleepy,
+                &textures.friendlySleepy,
+                &textures.transform,
+            });
+        return pointers;
+    }
+
+    // The simulation state between two runFrame calls. Presentation state (the profiler overlay, the text run cache)
+    // isn't part of it, and neither is the input, which a replay restores by running the recording up to frame.
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(currentLevel, registry, mapWidth, mapHeight, cells, spatialIndex, rayDistances, playerEntities, entitiesNeeded);
+        archive(tickTimer, animationFrameTimer, tweenFrameTimer, tweenFrame, tween, mapViewCenter, prevMapViewCenter);
+        archive(inputQueue, inputSpriteEntities, gubgubCounterText, frame);
+    }
+
+    std::vector<std::byte> saveSnapshot()
+    {
+        snapshot::Writer writer;
+        writer.pointers = snapshotPointers();
+        uint32_t magic = snapshotMagic;
+        uint32_t version = snapshotVersion;
+        writer(magic, version);
+        serialize(writer);
+        return std::move(writer.data);
+    }
+
+    std::vector<std::byte> takeRequestedSnapshot() override
+    {
+        return std::exchange(snapshotRequested, false) ? saveSnapshot() : std::vector<std::byte>();
+    }
+
+    // Only for snapshots of the same build and level pack, taken after init.
+    void loadSnapshot(std::span<const std::byte> data)
+    {
+        snapshot::Reader reader(data);
+        reader.pointers = snapshotPointers();
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        reader(magic, version);
+        if (magic != snapshotMagic || version != snapshotVersion)
+        {
+            throw std::runtime_error("Not a snapshot of this version");
+        }
+        serialize(reader);
+        if (!reader.done())
+        {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        tileMapDirty = true;
+    }
+
+    void gameTick()
+    {
+        for (const auto id : component<Transient>().entities)
+        {
+            destroyLater(id);
+        }
+        if (!inputSpriteEntities.empty() && component<InputIcon>().get(inputSpriteEntities.front()).completed)
+        {
+            destroyLater(inputSpriteEntities.front());
+            inputSpriteEntities.pop_front();
+        }
+        applyCommands();
+
+        component<Sprite>().forEach([&](Sprite& sprite, uint32_t id)
+        {
+            sprite.prevx = sprite.x;
+            sprite.prevy = sprite.y;
+        });
+        if (!inputQueue.empty())
+        {
+            InputEvent event = inputQueue.front();
+            inputQueue.pop_front();
+            component<InputIcon>().get(inputSpriteEntities.front()).completed = true;
+            auto& sprite = component<Sprite>().get(inputSpriteEntities.front());
+            sprite.y -= 1;
+
+            for (uint32_t i = 1; i < inputSpriteEntities.size(); ++i)
+            {
+                auto id = inputSpriteEntities[i];
+                auto& sprite = component<Sprite>().get(id);
+                sprite.x += 1;
+            }
+
+            if (!playerEntities.empty())
+            {
+                component<CharacterAnimator>().get(playerEntities.front()).direction = event.direction;
+                const auto& coords = component<MapCoords>().get(playerEntities.front());
+
+                auto [dx, dy] = directionCoords(event.direction);
+                clampDeltaToMap(coords.x, coords.y, dx, dy);
+
+                const auto& cell = cellAt(coords.x + dx, coords.y + dy);
+                if (!cell.solid)
+                {
+                    bool blocked = false;
+                    bool attack = false;
+                    bool capture = false;
+                    uint32_t target = Entity::Invalid;
+                    spatialIndex.forEachOccupant(cell.x, cell.y, [&](const uint32_t oid, const uint32_t mask)
+                        {
+                            if (mask & bit<Enemy>())
+                            {
+                                attack = true;
+                                target = oid;
+                                return true;
+                            }
+                            if ((mask & bit<Neutral>()) ||
+                                ((mask & bit<Friendly>()) &&
+                                     std::find(playerEntities.begin(), playerEntities.end(), oid) == playerEntities.end()))
+                            {
+                                capture = true;
+                                target = oid;
+                                return true;
+                            }
+                            if (mask & bit<Solid>())
+                            {
+                                blocked = true;
+                                return true;
+                            }
+                            return false;
+                        });
+
+                    if (!blocked)
+                    {
+                        if (attack)
+                        {
+                            component<Enemy>().remove(target);
+                            component<Neutral>().add(target).wasFriendly = false;
+                            component<CharacterAnimator>().remove(target);
+                            component<SequenceAnimator>().get(target).sequence = &textures.enemySleepy;
+
+                            uint32_t bonker = createEntity();
+                            component<MapCoords>().add(bonker);
+                            component<Sprite>().add(bonker);
+                            component<SequenceAnimator>().add(bonker).sequence = &textures.bonk;
+                            component<Transient>().add(bonker);
+                            moveEntity(bonker, coords.x + dx, coords.y + dy);
+                        }
+                        else
+                        {
+                            if (capture)
+                            {
+                                if (component<Neutral>().has(target))
+                                {
+                                    component<Neutral>().remove(target);
+                                    component<Friendly>().add(target);
+                                    component<CharacterAnimator>().add(target) = {
+                                        .textureSet = &textures.friendly,
+                                    };
+                                }
+                                playerEntities.push_back(target);
+                            }
+
+                            for (uint32_t i = playerEntities.size() - 1; i > 0; --i)
+                            {
+                                const auto& nextCoords = component<MapCoords>().get(playerEntities[i - 1]);
+                                moveEntity(playerEntities[i], nextCoords.x, nextCoords.y);
+                            }
+
+                            moveEntity(playerEntities.front(), coords.x + dx, coords.y + dy);
+                            const auto& cell = cellAt(coords.x, coords.y);
+                            if (const auto door = findOccupant(cell, bit<Door>()); door != Entity::Invalid)
+                            {
+                                if (component<Door>().get(door).open)
+                                {
+                                    if (currentLevel + 1 < levels->size())
+                                    {
+                                        loadLevel(currentLevel + 1);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        for (uint32_t i = 1; i < playerEntities.size(); ++i)
+        {
+            const auto& coords = component<MapCoords>().get(playerEntities[i]);
+            const auto& nextCoords = component<MapCoords>().get(playerEntities[i - 1]);
+            component<CharacterAnimator>().get(playerEntities[i]).direction = directionFromDelta((int)nextCoords.x - (int)coords.x, (int)nextCoords.y - (int)coords.y);
+        }
+
+        if (entitiesNeeded > 0)
+        {
+            component<Text>().get(gubgubCounterText).text = "GubGubs: " + std::to_string(playerEntities.size()) + " / " + std::to_string(entitiesNeeded);
+        }
+        else
+        {
+            component<Text>().get(gubgubCounterText).text = "";
+        }
+        component<Door>().forEach([&](Door& door, uint32_t id)
+        {
+            const bool open = playerEntities.size() >= entitiesNeeded;
+            if (open != door.open)
+            {
+                door.open = open;
+                if (open)
+                {
+                    component<Solid>().remove(id);
+                    component<Sprite>().get(id).textureIndex = textures.doorOpen;
+                }
+                else
+                {
+                    component<Solid>().add(id);
+                    component<Sprite>().get(id).textureIndex = textures.doorClosed;
+                }
+            }
+        });
+
+        component<Neutral>().forEach([this](Neutral& neutral, uint32_t id)
+        {
+            if (neutral.cooldown == 0)
+            {
+                component<Enemy>().add(id);
+                component<CharacterAnimator>().add(id) = {
+                    .textureSet = &textures.enemy,
+                };
+                registry.removeLater<Neutral>(id);
+            }
+            else
+            {
+                --neutral.cooldown;
+                if (neutral.cooldown == 0 && neutral.wasFriendly)
+                {
+                    component<SequenceAnimator>().get(id).sequence = &textures.transform;
+                }
+            }
+        });
+
+        {
+            eng::ProfileScope scope("enemyLogic");
+            component<Enemy>().forEach([this](Enemy& enemy, uint32_t id)
+            {
+                enemyLogic(enemy, id);
+            });
+        }
+
+        view<MapCoords, Sprite>([](const MapCoords& mapCoords, Sprite& sprite, uint32_t id)
+        {
+            sprite.x = mapCoords.x;
+            sprite.y = mapCoords.y;
+        });
+    }
+
+    void runFrame(eng::SceneInterface& scene, eng::InputInterface& input, const double deltaTime) override
+    {
+        if (input.getBoolean(snapshotMapping, eng::InputInterface::BoolStateEvent::Pressed))
+        {
+            snapshotRequested = true;
+        }
+        ++frame;
+
+        if (input.getBoolean(profilerOverlayMapping, eng::InputInterface::BoolStateEvent::Pressed))
+        {
+            profilerOverlay = !profilerOverlay;
+        }
+
+        for (auto&& [ direction, mapping ] : directionInputMappings)
+        {
+            if (input.getBoolean(mapping, eng::InputInterface::BoolStateEvent::Pressed))
+            {
+                // inputQueue.clear();
+                inputQueue.push_back(InputEvent { direction });
+                uint32_t offset = inputSpriteEntities.size();
+                if (!inputSpriteEntities.empty() && component<InputIcon>().get(inputSpriteEntities.front()).completed)
+                {
+                    --offset;
+                }
+                uint32_t id = createEntity();
+                component<Sprite>().add(id) = Sprite{
+                    .textureIndex = textures.arrow,
+                    .color = { 1, 1, 0, 1 },
+                    .direction = direction,
+                    .x = maxTilesHorizontal - 1 - offset,
+                    .y = maxTilesVertical - 1,
+                };
+                component<InputIcon>().add(id);
+                inputSpriteEntities.push_back(id);
+            }
+        }
+
+        if (animationFrameTimer >= animationFrameInterval)
+        {
+            component<Enemy>().forEach([&](Enemy& enemy, uint32_t id)
+            {
+                ++enemy.lineFrame;
+            });
+
+            component<SequenceAnimator>().forEach([&](SequenceAnimator& animator, uint32_t id)
+            {
+                ++animator.frame;
+            });
+
+            animationFrameTimer -= animationFrameInterval;
+        }
+        animationFrameTimer += deltaTime;
+
+        if (tickTimer >= tickInterval)
+        {
+            prevMapViewCenter = mapViewCenter;
+            if (!playerEntities.empty())
+            {
+                const auto& coords = component<MapCoords>().get(playerEntities.front());
+                mapViewCenter = glm::vec2(coords.x + 0.5, maxTilesVertical - coords.y - 0.5);
+            }
+
+            {
+                eng::ProfileScope scope("gameTick");
+                gameTick();
+            }
+            tickTimer -= tickInterval;
+            tweenFrame = 0;
+        }
+        tickTimer += deltaTime;
+
+        if (tweenFrameTimer >= tweenFrameInterval)
+        {
+            constexpr int tweenEndFrame = tweenFramesPerTick / 2;
+            tween = glm::clamp<float>(static_cast<float>(tweenFrame) / tweenEndFrame, 0, 1);
+            tween = 3 * tween * tween - 2 * tween * tween * tween;
+            tween = std::round(tween * texelsPerTile) / texelsPerTile;
+            ++tweenFrame;
+
+            if (!inputSpriteEntities.empty() && component<InputIcon>().get(inputSpriteEntities.front()).completed)
+            {
+                component<Sprite>().get(inputSpriteEntities.front()).color.a = 1.0f - tween;
+            }
+
+            tweenFrameTimer -= tweenFrameInterval;
+        }
+        tweenFrameTimer += deltaTime;
+
+        glm::vec2 mapViewCenterOffset = glm::mix(prevMapViewCenter, mapViewCenter, tween) - glm::vec2(0.5f * maxTilesHorizontal, 0.5f * maxTilesVertical);
+
+        if (tileMapDirty)
+        {
+            eng::TileMap tileMap {
+                .width = mapWidth,
+                .height = mapHeight,
+                .position = glm::vec2(0.5 * mapWidth, maxTilesVertical - 0.5 * mapHeight),
+                .backgroundTextureIndex = textures.floor,
+            };
+            tileMap.tiles.reserve(tileMap.width * tileMap.height);
+            for (const auto& cell : cells)
+            {
+                tileMap.tiles.push_back(cell.solid ? textures.wall : eng::TileMap::Empty);
+            }
+            scene.setTileMap(std::move(tileMap));
+            tileMapDirty = false;
+        }
+        scene.retainedInstanceOffset() = -mapViewCenterOffset;
+
+        // The layers touch disjoint components, so they are built in parallel. Flushing removals would write the mask
+        // table and the spatial index they share, so they iterate without.
+        auto& spriteInstances = scene.instances(SpriteLayer);
+        auto& sightlineInstances = scene.instances(SightlineLayer);
+        auto& textInstances = scene.instances(TextLayer);
+        auto& spriteKeys = scene.instanceKeys(SpriteLayer);
+        auto& sightlineKeys = scene.instanceKeys(SightlineLayer);
+        auto& textKeys = scene.instanceKeys(TextLayer);
+        scene.runInParallel({
+            [&]
+            {
+                spriteInstances.clear();
+                spriteKeys.clear();
+                viewNoFlush<CharacterAnimator, SequenceAnimator, Sprite>([](const CharacterAnimator& animator, SequenceAnimator& sequenceAnimator, Sprite& sprite, uint32_t id)
+                {
+                    if (animator.textureSet)
+                    {
+                        sequenceAnimator.sequence = &(animator.direction == Direction::Up ? animator.textureSet->back
+                            : animator.direction == Direction::Down ? animator.textureSet->front : animator.textureSet->side);
+                        sprite.flipHorizontal = animator.direction == Direction::Right;
+                    }
+                });
+
+                viewNoFlush<SequenceAnimator, Sprite>([](SequenceAnimator& animator, Sprite& sprite, uint32_t id)
+                {
+                    if (animator.sequence)
+                    {
+                        if (animator.frame >= animator.sequence->size())
+                        {
+                            animator.frame = 0;
+                        }
+                        sprite.textureIndex = (*animator.sequence)[animator.frame];
+                    }
+                });
+
+                component<Sprite>().forEachNoFlush([&](const Sprite& sprite, uint32_t id)
+                {
+                    glm::vec2 position(sprite.x + 0.5, maxTilesVertical - sprite.y - 0.5);
+                    if (tween < 1.0f && sprite.prevx != std::numeric_limits<uint32_t>::max() && sprite.prevy != std::numeric_limits<uint32_t>::max()
+                            && (sprite.prevx != sprite.x || sprite.prevy != sprite.y))
+                    {
+                        position = glm::mix(glm::vec2(sprite.prevx + 0.5, maxTilesVertical - sprite.prevy - 0.5), position, tween);
+                    }
+                    if (component<MapCoords>().has(id))
+                    {
+                        position -= mapViewCenterOffset;
+                    }
+                    spriteInstances.push_back(eng::Instance {
+                                .position = position,
+                                .minTexCoord = { sprite.flipHorizontal ? 1 : 0, 0 },
+                                .texCoordScale = { sprite.flipHorizontal ? -1 : 1, 1 },
+                                .angle = directionAngle(sprite.direction),
+                                .textureIndex = sprite.textureIndex,
+                                .tintColor = sprite.color,
+                            });
+                    spriteKeys.push_back(id);
+                });
+            },
+            [&]
+            {
+                sightlineInstances.clear();
+                sightlineKeys.clear();
+                viewNoFlush<Enemy, MapCoords>([&](Enemy& enemy, const MapCoords& mapCoords, uint32_t id)
+                {
+                    uint32_t textureIndex;
+                    uint32_t endTextureIndex;
+                    glm::vec4 tintColor = { 1, 1, 1, 1 };
+                    if (enemy.state == Enemy::State::Attack)
+                    {
+                        if (enemy.lineFrame >= textures.zap.size())
+                        {
+                            enemy.lineFrame = 0;
+                        }
+                        textureIndex = textures.zap[enemy.lineFrame];
+                        endTextureIndex = textures.zapHit[enemy.lineFrame];
+                    }
+                    else
+                    {
+                        if (enemy.lineFrame >= textures.sightline.size())
+                        {
+                            enemy.lineFrame = 0;
+                        }
+                        textureIndex = textures.sightline[enemy.lineFrame];
+                        endTextureIndex = textures.sightlineEnd[enemy.lineFrame];
+                        if (enemy.state == Enemy::State::Alert)
+                        {
+                            tintColor = { 1, 1, 0, 1 };
+                        }
+                        else if (enemy.state == Enemy::State::Aggressive)
+                        {
+                            tintColor = { 1, 0, 0, 1 };
+                        }
+                    }
+                    float angle = directionAngle(enemy.facingDirection) - glm::half_pi<float>();
+
+                    const auto [dx, dy] = directionCoords(enemy.facingDirection);
+                    const Cell* stop = scanStop(mapCoords.x, mapCoords.y, enemy.facingDirection);
+                    const uint32_t lineLength = scanDistance(mapCoords.x, mapCoords.y, enemy.facingDirection) - (stop ? 1 : 0);
+                    for (uint32_t i = 1; i <= lineLength; ++i)
+                    {
+                        sightlineInstances.push_back(eng::Instance {
+                                    .position = glm::vec2(mapCoords.x + i * dx + 0.5, maxTilesVertical - (mapCoords.y + i * dy) - 0.5) - mapViewCenterOffset,
+                                    .angle = angle,
+                                    .textureIndex = textureIndex,
+                                    .tintColor = tintColor,
+                                });
+                    }
+                    sightlineKeys.resize(sightlineInstances.size(), id);
+                    if (stop)
+                    {
+                        const auto solid = findOccupant(*stop, bit<Solid>());
+                        if (spatialIndex.occupantMask(solid) & (bit<Friendly>() | bit<Neutral>()))
+                        {
+                            sightlineInstances.push_back(eng::Instance {
+                                        .position = glm::vec2(stop->x + 0.5, maxTilesVertical - stop->y - 0.5) - mapViewCenterOffset,
+                                        .angle = angle,
+                                        .textureIndex = endTextureIndex,
+                                        .tintColor = tintColor,
+                                    });
+                            sightlineKeys.push_back(id);
+                        }
+                    }
+                });
+            },
+            [&]
+            {
+                textInstances.clear();
+                textKeys.clear();
+                component<Text>().forEachNoFlush([&](const Text& text, uint32_t id)
+                {
+                    textRuns.draw(id, text, textInstances);
+                    textKeys.resize(textInstances.size(), id);
+                });
+                if (const auto profiler = eng::Profiler::active(); profiler && profilerOverlay)
+                {
+                    const auto stats = profiler->lastFrame();
+                    char line[128];
+                    std::snprintf(line, sizeof(line), "FRAME %.2f MS  WAIT %.2f MS  GPU %.2f MS  %u INSTANCES  %.1f KB", stats.frameTime * 1000, stats.waitTime * 1000, stats.gpuTime * 1000, stats.numInstances, stats.bytesUploaded / 1024.0);
+                    textRuns.draw(Entity::Invalid, Text {
+                            .text = line,
+                            .position = { 0.5, maxTilesVertical - 1.25f },
+                            .scale = { 0.4, 0.4 },
+                            .background = { 0, 0, 0, 0.8 },
+                        }, textInstances);
+                    textKeys.resize(textInstances.size(), Entity::Invalid);
+                }
+                textRuns.collect();
+            },
+        });
+
+        const auto [framebufferWidth, framebufferHeight] = scene.framebufferSize();
+        const float aspectRatio = static_cast<float>(framebufferWidth) / static_cast<float>(framebufferHeight);
+        if (maxTilesVertical * aspectRatio > maxTilesHorizontal)
+        {
+            const float framebufferPixelsPerTile = static_cast<float>(framebufferHeight) / static_cast<float>(maxTilesVertical);
+            const float viewportWidth = maxTilesHorizontal * framebufferPixelsPerTile;
+            scene.viewportOffset() = { (static_cast<float>(framebufferWidth) - viewportWidth) / 2, 0 };
+            scene.viewportExtent() = { viewportWidth, framebufferHeight };
+        }
+        else
+        {
+            const float framebufferPixelsPerTile = static_cast<float>(framebufferWidth) / static_cast<float>(maxTilesHorizontal);
+            const float viewportHeight = maxTilesVertical * framebufferPixelsPerTile;
+            scene.viewportOffset() = { 0, (static_cast<float>(framebufferHeight) - viewportHeight) / 2 };
+            scene.viewportExtent() = { framebufferWidth, viewportHeight };
+        }
+        scene.projection() = glm::orthoLH_ZO<float>(0.0f, maxTilesHorizontal, maxTilesVertical, 0.0f, 0.0f, 1.0f);
+    }
+
+    void cleanup() override
+    {
+    }
+};
@@ -0,0 +1,107 @@
+#include "gpu_instance.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace eng;
+
+GpuInstance eng::packInstance(const Instance& instance)
+{
+    return GpuInstance {
+        .position = instance.position,
+        .scale = instance.scale,
+        .minTexCoord = instance.minTexCoord,
+        .texCoordScale = instance.texCoordScale,
+        .rotation = { glm::cos(instance.angle), glm::sin(instance.angle) },
+        .textureIndex = instance.textureIndex,
+        .samplerIndex = static_cast<uint32_t>(instance.sampler),
+        .tintColor = instance.tintColor,
+    };
+}
+
+#ifdef USE_SSE2
+// Cephes style sincos: reduce to [-pi/4, pi/4] around the nearest multiple of pi/2, then pick and negate per quadrant
+static void sinCos(__m128 x, __m128& sinOut, __m128& cosOut)
+{
+    const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236758134f)));
+    const __m128 q = _mm_cvtepi32_ps(quadrant);
+    x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(4.837512969970703125e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(7.54978995489188216e-8f)));
+
+    const __m128 x2 = _mm_mul_ps(x, x);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), x2), _mm_set1_ps(8.3321608736e-3f));
+    s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(-1.6666654611e-1f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, x2), x), x);
+
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), x2), _mm_set1_ps(-1.388731625493765e-3f));
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(4.166664568298827e-2f));
+    c = _mm_mul_ps(_mm_mul_ps(c, x2), x2);
+    c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(x2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+    sinOut = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sinSign);
+    cosOut = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosSign);
+}
+
+static void streamInstance(const Instance& instance, const float cosAngle, const float sinAngle, GpuInstance* destination)
+{
+    auto out = reinterpret_cast<float*>(destination);
+    _mm_stream_ps(out, _mm_setr_ps(instance.position.x, instance.position.y, instance.scale.x, instance.scale.y));
+    _mm_stream_ps(out + 4, _mm_setr_ps(instance.minTexCoord.x, instance.minTexCoord.y, instance.texCoordScale.x, instance.texCoordScale.y));
+    _mm_stream_ps(out + 8, _mm_setr_ps(cosAngle, sinAngle, std::bit_cast<float>(instance.textureIndex), std::bit_cast<float>(static_cast<uint32_t>(instance.sampler))));
+    _mm_stream_ps(out + 12, _mm_setr_ps(instance.tintColor.x, instance.tintColor.y, instance.tintColor.z, instance.tintColor.w));
+}
+#endif
+
+void eng::packInstances(const Instance* instances, const size_t count, GpuInstance* destination)
+{
+    size_t i = 0;
+#ifdef USE_SSE2
+    alignas(16) float sinAngles[4];
+    alignas(16) float cosAngles[4];
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sinAngle, cosAngle;
+        sinCos(_mm_setr_ps(instances[i].angle, instances[i + 1].angle, instances[i + 2].angle, instances[i + 3].angle), sinAngle, cosAngle);
+        _mm_store_ps(sinAngles, sinAngle);
+        _mm_store_ps(cosAngles, cosAngle);
+        for (size_t j = 0; j < 4; ++j)
+        {
+            streamInstance(instances[i + j], cosAngles[j], sinAngles[j], destination + i + j);
+        }
+    }
+    _mm_sfence();
+#endif
+    for (; i < count; ++i)
+    {
+        destination[i] = packInstance(instances[i]);
+    }
+}
+
+void eng::streamInstances(const GpuInstance* instances, const size_t count, GpuInstance* destination)
+{
+#ifdef USE_SSE2
+    auto in = reinterpret_cast<const __m128*>(instances);
+    auto out = reinterpret_cast<__m128*>(destination);
+    for (size_t i = 0; i < 4 * count; i += 4)
+    {
+        _mm_stream_ps(reinterpret_cast<float*>(out + i), in[i]);
+        _mm_stream_ps(reinterpret_cast<float*>(out + i + 1), in[i + 1]);
+        _mm_stream_ps(reinterpret_cast<float*>(out + i + 2), in[i + 2]);
+        _mm_stream_ps(reinterpret_cast<float*>(out + i + 3), in[i + 3]);
+    }
+    _mm_sfence();
+#else
+    std::memcpy(destination, instances, count * sizeof(GpuInstance));
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "engine.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace eng
+{
+    // Matches the std140 Instance struct in test.vs.glsl, so arrays of it can be copied into the instance buffer as is.
+    struct alignas(16) GpuInstance
+    {
+        glm::vec2 position = { 0, 0 };
+        glm::vec2 scale = { 1, 1 };
+        glm::vec2 minTexCoord = { 0, 0 };
+        glm::vec2 texCoordScale = { 1, 1 };
+        glm::vec2 rotation = { 1, 0 };
+        uint32_t textureIndex = 0;
+        uint32_t samplerIndex = 0;
+        glm::vec4 tintColor = { 1, 1, 1, 1 };
+    };
+
+    static_assert(offsetof(GpuInstance, position) == 0);
+    static_assert(offsetof(GpuInstance, scale) == 8);
+    static_assert(offsetof(GpuInstance, minTexCoord) == 16);
+    static_assert(offsetof(GpuInstance, texCoordScale) == 24);
+    static_assert(offsetof(GpuInstance, rotation) == 32);
+    static_assert(offsetof(GpuInstance, textureIndex) == 40);
+    static_assert(offsetof(GpuInstance, samplerIndex) == 44);
+    static_assert(offsetof(GpuInstance, tintColor) == 48);
+    static_assert(sizeof(GpuInstance) == 64);
+
+    GpuInstance packInstance(const Instance& instance);
+
+    // Converts a batch of instances straight into (usually write-combined) mapped memory,
+    // using vectorized sin/cos and non-temporal stores where available.
+    void packInstances(const Instance* instances, const size_t count, GpuInstance* destination);
+
+    // Copies already packed instances into mapped memory with non-temporal stores where available.
+    void streamInstances(const GpuInstance* instances, const size_t count, GpuInstance* destination);
+}
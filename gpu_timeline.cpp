@@ -0,0 +1,72 @@
+#include "gpu_timeline.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using eng::GpuTimeline;
+
+static vk::raii::Semaphore createTimelineSemaphore(const vk::raii::Device& device)
+{
+    const vk::StructureChain semaphoreCreateInfoChain {
+        vk::SemaphoreCreateInfo {},
+        vk::SemaphoreTypeCreateInfo {
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue = 0,
+        },
+    };
+    return vk::raii::Semaphore(device, semaphoreCreateInfoChain.get<vk::SemaphoreCreateInfo>());
+}
+
+GpuTimeline::GpuTimeline(const vk::raii::Device& device) :
+    device(device),
+    semaphore(createTimelineSemaphore(device))
+{
+}
+
+vk::SemaphoreSubmitInfo GpuTimeline::signal(const vk::PipelineStageFlags2 stageMask)
+{
+    return vk::SemaphoreSubmitInfo {
+        .semaphore = semaphore,
+        .value = ++signaled,
+        .stageMask = stageMask,
+    };
+}
+
+bool GpuTimeline::completed(const uint64_t value)
+{
+    if (completedValue < value)
+    {
+        completedValue = semaphore.getCounterValue();
+    }
+    return completedValue >= value;
+}
+
+void GpuTimeline::wait(const uint64_t value)
+{
+    if (completedValue >= value)
+    {
+        return;
+    }
+    if (auto result = device.waitSemaphores(vk::SemaphoreWaitInfo {
+                .semaphoreCount = 1,
+                .pSemaphores = &*semaphore,
+                .pValues = &value,
+            }, std::numeric_limits<uint64_t>::max());
+            result != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Unexpected return from waitSemaphores");
+    }
+    completedValue = std::max(completedValue, value);
+}
+
+void GpuTimeline::collect()
+{
+    if (retired.empty())
+    {
+        return;
+    }
+    // refreshes completedValue
+    completed(signaled);
+    std::erase_if(retired, [&](const auto& entry) { return entry.first <= completedValue; });
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vulkan_includes.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eng
+{
+    // One timeline semaphore counting GPU progress. Every submission to the graphics queue signals the next value, so
+    // "value X completed" means everything submitted up to that point is done. Resources still in use by the GPU are
+    // handed to retire and destroyed by collect once the GPU is past them. Only used from the render thread.
+    struct GpuTimeline
+    {
+        explicit GpuTimeline(const vk::raii::Device& device);
+
+        GpuTimeline(const GpuTimeline&) = delete;
+        GpuTimeline& operator=(const GpuTimeline&) = delete;
+
+        // Reserves the value for the next submission, submissions have to signal them in the order they were reserved.
+        vk::SemaphoreSubmitInfo signal(const vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eAllCommands);
+        uint64_t lastSignaled() const { return signaled; }
+
+        // cached, queries the semaphore only while value isn't known to be reached
+        bool completed(const uint64_t value);
+        void wait(const uint64_t value);
+
+        // keeps resource alive until everything submitted so far is done
+        template<typename T>
+        void retire(T&& resource)
+        {
+            retire(signaled, std::forward<T>(resource));
+        }
+
+        template<typename T>
+        void retire(const uint64_t value, T&& resource)
+        {
+            if (value == 0)
+            {
+                return;
+            }
+            retired.emplace_back(value, std::make_shared<std::decay_t<T>>(std::forward<T>(resource)));
+        }
+
+        // destroys the retired resources the GPU is done with
+        void collect();
+
+        const vk::raii::Device& device;
+        const vk::raii::Semaphore semaphore;
+        uint64_t signaled = 0;
+        uint64_t completedValue = 0;
+        std::vector<std::pair<uint64_t, std::shared_ptr<void>>> retired;
+    };
+}
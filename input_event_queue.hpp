@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace eng
+{
+    struct InputEvent
+    {
+        enum class Type
+        {
+            Key,
+            MouseButton,
+            Cursor,
+        };
+
+        Type type;
+        // scancode, mouse button or cursor axis
+        int code;
+        // 1 for down and 0 for up, the position for the cursor
+        double value;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    // Lock-free ring between the window callbacks, which push, and whichever thread runs the game logic, which pops.
+    // Exactly one thread may push and one may pop.
+    class InputEventQueue
+    {
+    public:
+        static constexpr uint32_t capacity = 1024;
+
+        // drops the event when the consumer is that far behind
+        bool push(const InputEvent& event)
+        {
+            const uint32_t tail = this->tail.load(std::memory_order_relaxed);
+            if (tail - head.load(std::memory_order_acquire) == capacity)
+            {
+                return false;
+            }
+            events[tail % capacity] = event;
+            this->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // oldest event, or nullptr when empty, stays valid until pop
+        const InputEvent* front() const
+        {
+            const uint32_t head = this->head.load(std::memory_order_relaxed);
+            return head == tail.load(std::memory_order_acquire) ? nullptr : &events[head % capacity];
+        }
+
+        void pop()
+        {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        static_assert((capacity & (capacity - 1)) == 0, "the indices wrap around, so the capacity has to divide 2^32");
+
+        std::array<InputEvent, capacity> events;
+        alignas(64) std::atomic<uint32_t> head = 0;
+        alignas(64) std::atomic<uint32_t> tail = 0;
+    };
+}
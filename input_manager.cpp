@@ -1,25 +1,9 @@
 #include "input_manager.hpp"
 
-#include <GLFW/glfw3.h>
+#include <utility>
 
 using eng::InputManager;
 
-void InputManager::handleKey(int key, int scancode, int action, int mods)
-{
-    updateStateBoolean(keyMap, scancode, action != GLFW_RELEASE);
-}
-
-void InputManager::handleMouseButton(int button, int action, int mods)
-{
-    updateStateBoolean(mouseButtonMap, button, action != GLFW_RELEASE);
-}
-
-void InputManager::handleCursorPosition(double x, double y)
-{
-    updateStateReal(cursorMap, static_cast<int>(CursorAxis::X), x);
-    updateStateReal(cursorMap, static_cast<int>(CursorAxis::Y), y);
-}
-
 InputManager::InputManager()
 {
     inputs.push_back(Input {});
@@ -37,7 +21,7 @@ uint32_t InputManager::createMapping()
 void InputManager::mapKey(const uint32_t mapping, const int scancode)
 {
     unmap(mapping);
-    map(mapping, getInputIndex(keyMap, scancode, Input {
+    map(mapping, getInputIndex(scancode, Input {
                 .inputType = InputType::Key,
                 .code = scancode,
             }));
@@ -46,7 +30,7 @@ void InputManager::mapKey(const uint32_t mapping, const int scancode)
 void InputManager::mapMouseButton(const uint32_t mapping, const int scancode)
 {
     unmap(mapping);
-    map(mapping, getInputIndex(mouseButtonMap, scancode, Input {
+    map(mapping, getInputIndex(scancode, Input {
                 .inputType = InputType::MouseButton,
                 .code = scancode,
             }));
@@ -55,7 +39,7 @@ void InputManager::mapMouseButton(const uint32_t mapping, const int scancode)
 void InputManager::mapCursor(const uint32_t mapping, const CursorAxis axis)
 {
     unmap(mapping);
-    map(mapping, getInputIndex(cursorMap, static_cast<int>(axis), Input {
+    map(mapping, getInputIndex(static_cast<int>(axis), Input {
                 .inputType = InputType::Cursor,
                 .code = static_cast<int>(axis),
             }));
@@ -71,10 +55,10 @@ bool InputManager::getBoolean(const uint32_t mapping, const BoolStateEvent event
             value = input.state.boolean;
             break;
         case BoolStateEvent::Pressed:
-            value = input.state.boolean && !input.previousState.boolean;
+            value = input.pressed;
             break;
         case BoolStateEvent::Released:
-            value = !input.state.boolean && input.previousState.boolean;
+            value = input.released;
             break;
     }
     return value;
@@ -101,6 +85,48 @@ void InputManager::nextFrame()
     for (auto& input : inputs)
     {
         input.previousState = input.state;
+        input.pressed = false;
+        input.released = false;
+    }
+}
+
+void InputManager::handleEvents(InputEventQueue& queue, const std::chrono::steady_clock::time_point until)
+{
+    handleEvents(queue, until, [](const InputEvent&) {});
+}
+
+void InputManager::handleEvent(const InputEvent& event)
+{
+    InputType inputType = InputType::Key;
+    switch (event.type)
+    {
+        case InputEvent::Type::Key:
+            inputType = InputType::Key;
+            break;
+        case InputEvent::Type::MouseButton:
+            inputType = InputType::MouseButton;
+            break;
+        case InputEvent::Type::Cursor:
+            inputType = InputType::Cursor;
+            break;
+    }
+    const auto& table = inputTable(inputType);
+    if (event.code < 0 || static_cast<size_t>(event.code) >= table.size() || table[event.code] == 0)
+    {
+        return;
+    }
+
+    Input& input = inputs[table[event.code]];
+    if (inputType == InputType::Cursor)
+    {
+        input.state.real = event.value;
+    }
+    else
+    {
+        const bool down = event.value != 0;
+        input.pressed |= down && !input.state.boolean;
+        input.released |= !down && input.state.boolean;
+        input.state.boolean = down;
     }
 }
 
@@ -115,57 +141,49 @@ void InputManager::unmap(const uint32_t mapping)
     uint32_t inputIndex = mappings[mapping].inputIndex;
     if (inputIndex > 0 && (--inputs[inputIndex].mappingCount) == 0)
     {
-        switch (inputs[inputIndex].inputType)
-        {
-        case InputType::None:
-            break;
-        case InputType::Key:
-            keyMap.erase(inputs[inputIndex].code);
-            break;
+        inputTable(inputs[inputIndex].inputType)[inputs[inputIndex].code] = 0;
+        freeInputs.push_back(inputIndex);
+    }
+}
+
+std::vector<uint32_t>& InputManager::inputTable(const InputType inputType)
+{
+    switch (inputType)
+    {
         case InputType::MouseButton:
-            mouseButtonMap.erase(inputs[inputIndex].code);
-            break;
+            return mouseButtonInputs;
         case InputType::Cursor:
-            break;
-        }
-        freeInputs.push_back(inputIndex);
+            return cursorInputs;
+        default:
+            return keyInputs;
     }
 }
 
-uint32_t InputManager::getInputIndex(std::map<int, uint32_t>& map, const int code, Input&& input)
+uint32_t InputManager::getInputIndex(const int code, Input&& input)
 {
-    auto it = map.find(code);
-    if (it == map.end())
+    // unknown keys have a scancode of -1, they stay on the input that never changes
+    if (code < 0)
+    {
+        return 0;
+    }
+    auto& table = inputTable(input.inputType);
+    if (table.size() <= static_cast<size_t>(code))
+    {
+        table.resize(code + 1, 0);
+    }
+    if (table[code] == 0)
     {
-        bool inserted;
         if (freeInputs.empty())
         {
-            std::tie(it, inserted) = map.emplace(code, inputs.size());
-            inputs.push_back(std::forward<Input>(input));
+            table[code] = inputs.size();
+            inputs.push_back(std::move(input));
         }
         else
         {
-            uint32_t index = freeInputs.back();
+            table[code] = freeInputs.back();
             freeInputs.pop_back();
-            std::tie(it, inserted) = map.emplace(code, index);
-            inputs[index] = std::forward<Input>(input);
+            inputs[table[code]] = std::move(input);
         }
     }
-    return it->second;
-}
-
-void InputManager::updateStateBoolean(const std::map<int, uint32_t>& map, const int code, const bool state)
-{
-    if (auto it = map.find(code); it != map.end())
-    {
-        inputs[it->second].state.boolean = state;
-    }
-}
-
-void InputManager::updateStateReal(const std::map<int, uint32_t>& map, const int code, const double state)
-{
-    if (auto it = map.find(code); it != map.end())
-    {
-        inputs[it->second].state.real = state;
-    }
+    return table[code];
 }
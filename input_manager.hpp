@@ -1,8 +1,10 @@
-#include "engine.hpp"
+#pragma once
 
-#include <map>
+#include "engine.hpp"
+#include "input_event_queue.hpp"
 
-struct GLFWwindow;
+#include <chrono>
+#include <vector>
 
 namespace eng
 {
@@ -27,6 +29,10 @@ namespace eng
                 double real;
             } state, previousState;
 
+            // went down or up at some point since the last nextFrame, so taps shorter than a frame aren't lost
+            bool pressed = false;
+            bool released = false;
+
             int mappingCount = 0;
         };
 
@@ -47,22 +53,35 @@ namespace eng
 
         void nextFrame();
 
-        void handleKey(int key, int scancode, int action, int mods);
-        void handleMouseButton(int button, int action, int mods);
-        void handleCursorPosition(double x, double y);
+        // Applies the queued events that happened before until. Copies of this manager keep its mappings, so the thread
+        // running game logic can drain the queue into its own copy.
+        void handleEvents(InputEventQueue& queue, const std::chrono::steady_clock::time_point until);
+        void handleEvent(const InputEvent& event);
+
+        // also passes every applied event to onEvent
+        template<typename Callable>
+        void handleEvents(InputEventQueue& queue, const std::chrono::steady_clock::time_point until, Callable&& onEvent)
+        {
+            for (const InputEvent* event = queue.front(); event && event->time <= until; event = queue.front())
+            {
+                handleEvent(*event);
+                onEvent(*event);
+                queue.pop();
+            }
+        }
 
     private:
         void map(const uint32_t mapping, const uint32_t inputIndex);
         void unmap(const uint32_t mapping);
-        uint32_t getInputIndex(std::map<int, uint32_t>& map, const int code, Input&& input);
-        void updateStateBoolean(const std::map<int, uint32_t>& map, const int code, const bool state);
-        void updateStateReal(const std::map<int, uint32_t>& map, const int code, const double state);
+        std::vector<uint32_t>& inputTable(const InputType inputType);
+        uint32_t getInputIndex(const int code, Input&& input);
 
         std::vector<Input> inputs;
         std::vector<Mapping> mappings;
-        std::map<int, uint32_t> keyMap;
-        std::map<int, uint32_t> mouseButtonMap;
-        std::map<int, uint32_t> cursorMap;
+        // input index by code, 0 when unmapped
+        std::vector<uint32_t> keyInputs;
+        std::vector<uint32_t> mouseButtonInputs;
+        std::vector<uint32_t> cursorInputs;
         std::vector<uint32_t> freeInputs;
     };
 }
@@ -0,0 +1,66 @@
+#include "input_recording.hpp"
+
+#include <stdexcept>
+
+using eng::InputRecorder;
+using eng::InputRecording;
+
+InputRecorder::InputRecorder(const std::string& filePath, const double tickInterval) :
+    file(filePath, std::ios::binary | std::ios::trunc)
+{
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open input recording: " + filePath);
+    }
+    const input_recording::Header header {
+        .magic = input_recording::magic,
+        .version = input_recording::version,
+        .tickInterval = tickInterval,
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void InputRecorder::record(const uint64_t tick, const InputEvent& event)
+{
+    const input_recording::Record record {
+        .tick = tick,
+        .type = static_cast<uint32_t>(event.type),
+        .code = event.code,
+        .value = event.value,
+    };
+    file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+InputRecording::InputRecording(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open input recording: " + filePath);
+    }
+    input_recording::Header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != input_recording::magic || header.version != input_recording::version)
+    {
+        throw std::runtime_error("Invalid input recording: " + filePath);
+    }
+    tickInterval = header.tickInterval;
+
+    input_recording::Record record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        if (record.type > static_cast<uint32_t>(InputEvent::Type::Cursor) || (!records.empty() && record.tick < records.back().tick))
+        {
+            throw std::runtime_error("Invalid input recording: " + filePath);
+        }
+        records.push_back(record);
+    }
+}
+
+eng::InputEvent InputRecording::event(const input_recording::Record& record)
+{
+    return InputEvent {
+        .type = static_cast<InputEvent::Type>(record.type),
+        .code = record.code,
+        .value = record.value,
+    };
+}
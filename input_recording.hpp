@@ -0,0 +1,61 @@
+#pragma once
+
+#include "input_event_queue.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace eng
+{
+    // File layout: Header, then one Record per input event in the order the ticks consumed them. Timestamps are
+    // replaced by the index of the tick that consumed the event, so a replay with the same tick interval sees exactly
+    // the same input.
+    namespace input_recording
+    {
+        constexpr uint32_t magic = 0x43455249; // "IREC"
+        constexpr uint32_t version = 1;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            double tickInterval;
+        };
+
+        struct Record
+        {
+            uint64_t tick;
+            uint32_t type;
+            int32_t code;
+            double value;
+        };
+
+        static_assert(sizeof(Header) == 16);
+        static_assert(sizeof(Record) == 24);
+    }
+
+    class InputRecorder
+    {
+    public:
+        explicit InputRecorder(const std::string& filePath, const double tickInterval);
+
+        void record(const uint64_t tick, const InputEvent& event);
+
+    private:
+        std::ofstream file;
+    };
+
+    // A whole recording read into memory. A record cut off at the end, after a crash, is left out.
+    struct InputRecording
+    {
+        explicit InputRecording(const std::string& filePath);
+
+        // time is left at the epoch, recorded input is applied by tick
+        static InputEvent event(const input_recording::Record& record);
+
+        double tickInterval = 0;
+        std::vector<input_recording::Record> records;
+    };
+}
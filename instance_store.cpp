@@ -0,0 +1,71 @@
+#include "instance_store.hpp"
+
+#include <algorithm>
+#include <functional>
+
+using eng::InstanceStore;
+
+uint32_t InstanceStore::create(const Instance& instance)
+{
+    uint32_t handle;
+    if (!freeHandles.empty())
+    {
+        std::pop_heap(freeHandles.begin(), freeHandles.end(), std::greater {});
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        instances[handle] = packInstance(instance);
+    }
+    else
+    {
+        handle = instances.size();
+        instances.push_back(packInstance(instance));
+    }
+    markDirty(handle);
+    return handle;
+}
+
+void InstanceStore::update(const uint32_t handle, const Instance& instance)
+{
+    instances.at(handle) = packInstance(instance);
+    markDirty(handle);
+}
+
+void InstanceStore::destroy(const uint32_t handle)
+{
+    // zero scale produces degenerate triangles, so the hole costs no fragment work until it is reused
+    instances.at(handle) = GpuInstance { .scale = { 0, 0 } };
+    freeHandles.push_back(handle);
+    std::push_heap(freeHandles.begin(), freeHandles.end(), std::greater {});
+    markDirty(handle);
+}
+
+uint32_t InstanceStore::size() const
+{
+    return instances.size();
+}
+
+std::pair<uint32_t, uint32_t> InstanceStore::takeDirtyRange()
+{
+    std::pair<uint32_t, uint32_t> range { dirtyBegin, dirtyEnd };
+    dirtyBegin = std::numeric_limits<uint32_t>::max();
+    dirtyEnd = 0;
+    return range;
+}
+
+void InstanceStore::mirror(const std::vector<GpuInstance>& source, const std::pair<uint32_t, uint32_t> range)
+{
+    instances.resize(source.size());
+    const auto [begin, end] = range;
+    if (begin < end)
+    {
+        std::copy(source.begin() + begin, source.begin() + end, instances.begin() + begin);
+        markDirty(begin);
+        markDirty(end - 1);
+    }
+}
+
+void InstanceStore::markDirty(const uint32_t handle)
+{
+    dirtyBegin = std::min(dirtyBegin, handle);
+    dirtyEnd = std::max(dirtyEnd, handle + 1);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "engine.hpp"
+#include "gpu_instance.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace eng
+{
+    // Retained instances are packed once and live at stable slots so the renderer only has to upload the slots that changed.
+    // Destroyed slots are hidden and reused by later creates, lowest first. Retained instances are drawn in slot order.
+    struct InstanceStore
+    {
+        uint32_t create(const Instance& instance);
+        void update(const uint32_t handle, const Instance& instance);
+        void destroy(const uint32_t handle);
+
+        uint32_t size() const;
+
+        // Returns the range of slots modified since the last call as [begin, end) and resets it.
+        std::pair<uint32_t, uint32_t> takeDirtyRange();
+
+        // Takes over the size of another store's slots and copies the ones in range, which must cover every slot that
+        // differs. For keeping a copy of a store owned by another thread.
+        void mirror(const std::vector<GpuInstance>& source, const std::pair<uint32_t, uint32_t> range);
+
+        std::vector<GpuInstance> instances;
+        std::vector<uint32_t> freeHandles;
+        uint32_t dirtyBegin = std::numeric_limits<uint32_t>::max();
+        uint32_t dirtyEnd = 0;
+
+    private:
+        void markDirty(const uint32_t handle);
+    };
+}
@@ -0,0 +1,344 @@
+#include "level_pack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+static constexpr std::array<char, level_pack::NumSpawnKinds> spawnCharacters { 'P', 'E', 'F', 'T', 'D' };
+
+static uint64_t alignUp(const uint64_t value, const uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// written so a crafted offset can't wrap around
+static bool sectionFits(const uint64_t offset, const uint64_t size, const uint64_t dataSize)
+{
+    return offset <= dataSize && size <= dataSize - offset;
+}
+
+struct SourceLevel
+{
+    uint32_t entitiesNeeded = 0;
+    std::vector<std::string_view> rows;
+    std::vector<std::string_view> texts;
+};
+
+static std::runtime_error sourceError(const uint32_t line, const std::string& message)
+{
+    return std::runtime_error("Level source line " + std::to_string(line) + ": " + message);
+}
+
+static std::vector<SourceLevel> parseSource(const std::string_view source)
+{
+    std::vector<SourceLevel> levels;
+    uint32_t lineNumber = 0;
+    for (size_t begin = 0; begin < source.size();)
+    {
+        size_t end = source.find('\n', begin);
+        end = end == std::string_view::npos ? source.size() : end;
+        std::string_view line = source.substr(begin, end - begin);
+        begin = end + 1;
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        if (line.starts_with("level"))
+        {
+            auto& level = levels.emplace_back();
+            const auto count = line.substr(std::min<size_t>(line.size(), 6));
+            if (std::from_chars(count.data(), count.data() + count.size(), level.entitiesNeeded).ec != std::errc {})
+            {
+                throw sourceError(lineNumber, "expected the number of gubgubs needed after level");
+            }
+            continue;
+        }
+        if (levels.empty())
+        {
+            throw sourceError(lineNumber, "expected level before anything else");
+        }
+        auto& level = levels.back();
+        if (line.starts_with("text"))
+        {
+            level.texts.push_back(line.substr(std::min<size_t>(line.size(), 5)));
+            continue;
+        }
+
+        if (!level.rows.empty() && line.size() != level.rows.front().size())
+        {
+            throw sourceError(lineNumber, "map rows differ in width");
+        }
+        for (const char cell : line)
+        {
+            if (cell != 'X' && cell != '_' && std::find(spawnCharacters.begin(), spawnCharacters.end(), cell) == spawnCharacters.end())
+            {
+                throw sourceError(lineNumber, std::string("unknown map cell '") + cell + "'");
+            }
+        }
+        level.rows.push_back(line);
+    }
+
+    // the game starts on the first level
+    if (levels.empty())
+    {
+        throw std::runtime_error("Level source has no levels");
+    }
+    for (const auto& level : levels)
+    {
+        if (level.rows.empty())
+        {
+            throw std::runtime_error("Level source has a level without map rows");
+        }
+        if (level.rows.size() > UINT16_MAX || level.rows.front().size() > UINT16_MAX)
+        {
+            throw std::runtime_error("Level source has a level too large for the pack");
+        }
+    }
+    return levels;
+}
+
+template<typename T>
+static void writeAt(std::vector<std::byte>& pack, const uint64_t offset, const std::span<const T> values)
+{
+    const auto bytes = std::as_bytes(values);
+    std::copy(bytes.begin(), bytes.end(), pack.begin() + offset);
+}
+
+std::vector<std::byte> level_pack::compile(const std::string_view source)
+{
+    const auto sourceLevels = parseSource(source);
+
+    std::vector<Level> levels;
+    std::string strings;
+    uint64_t offset = sizeof(Header) + sourceLevels.size() * sizeof(Level);
+    std::vector<std::vector<std::byte>> solids;
+    std::vector<std::vector<Spawn>> spawns;
+    std::vector<std::vector<Text>> texts;
+    for (const auto& sourceLevel : sourceLevels)
+    {
+        const uint32_t width = sourceLevel.rows.front().size();
+        const uint32_t height = sourceLevel.rows.size();
+
+        auto& solid = solids.emplace_back((width * height + 7) / 8);
+        auto& levelSpawns = spawns.emplace_back();
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const char cell = sourceLevel.rows[y][x];
+                const uint32_t bit = y * width + x;
+                if (cell == 'X')
+                {
+                    solid[bit / 8] |= std::byte { 1 } << (bit % 8);
+                }
+                else if (const auto it = std::find(spawnCharacters.begin(), spawnCharacters.end(), cell); it != spawnCharacters.end())
+                {
+                    levelSpawns.push_back(Spawn {
+                            .kind = static_cast<uint32_t>(it - spawnCharacters.begin()),
+                            .x = static_cast<uint16_t>(x),
+                            .y = static_cast<uint16_t>(y),
+                        });
+                }
+            }
+        }
+        std::stable_sort(levelSpawns.begin(), levelSpawns.end(), [](const Spawn& a, const Spawn& b) { return a.kind < b.kind; });
+
+        auto& levelTexts = texts.emplace_back();
+        for (const auto text : sourceLevel.texts)
+        {
+            levelTexts.push_back(Text {
+                    .offset = static_cast<uint32_t>(strings.size()),
+                    .length = static_cast<uint32_t>(text.size()),
+                });
+            strings += text;
+        }
+
+        Level level {
+            .width = width,
+            .height = height,
+            .entitiesNeeded = sourceLevel.entitiesNeeded,
+            .numSpawns = static_cast<uint32_t>(levelSpawns.size()),
+            .numTexts = static_cast<uint32_t>(levelTexts.size()),
+            .padding = 0,
+        };
+        offset = alignUp(offset, sectionAlignment);
+        level.solidOffset = offset;
+        offset = alignUp(offset + solid.size(), sectionAlignment);
+        level.spawnsOffset = offset;
+        offset = alignUp(offset + levelSpawns.size() * sizeof(Spawn), sectionAlignment);
+        level.textsOffset = offset;
+        offset += levelTexts.size() * sizeof(Text);
+        levels.push_back(level);
+    }
+
+    const Header header {
+        .magic = magic,
+        .version = version,
+        .numLevels = static_cast<uint32_t>(levels.size()),
+        .stringTableSize = static_cast<uint32_t>(strings.size()),
+        .stringTableOffset = alignUp(offset, sectionAlignment),
+    };
+
+    std::vector<std::byte> pack(header.stringTableOffset + strings.size());
+    writeAt(pack, 0, std::span(&header, 1));
+    writeAt<Level>(pack, sizeof(Header), levels);
+    for (uint32_t i = 0; i < levels.size(); ++i)
+    {
+        writeAt<std::byte>(pack, levels[i].solidOffset, solids[i]);
+        writeAt<Spawn>(pack, levels[i].spawnsOffset, spawns[i]);
+        writeAt<Text>(pack, levels[i].textsOffset, texts[i]);
+    }
+    writeAt<char>(pack, header.stringTableOffset, strings);
+    return pack;
+}
+
+static bool packUpToDate(const std::string& packPath, const std::string& sourcePath)
+{
+    std::error_code error;
+    const auto packTime = std::filesystem::last_write_time(packPath, error);
+    if (error)
+    {
+        return false;
+    }
+    const auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    // without the source the pack is all there is
+    return error || packTime >= sourceTime;
+}
+
+LevelPack::LevelPack(const std::string& packPath, const std::string& sourcePath)
+{
+    if (packUpToDate(packPath, sourcePath))
+    {
+        // an empty or unreadable pack can't be mapped, which makes it as unusable as an invalid one
+        try
+        {
+            file.emplace(packPath);
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+        if (file)
+        {
+            data = file->data;
+            dataSize = file->size;
+            if (validate())
+            {
+                return;
+            }
+            file.reset();
+        }
+        if (!std::filesystem::exists(sourcePath))
+        {
+            throw std::runtime_error("Invalid level pack: " + packPath);
+        }
+    }
+
+    std::ifstream sourceFile(sourcePath, std::ios::binary);
+    if (!sourceFile)
+    {
+        throw std::runtime_error("Failed to open level source: " + sourcePath);
+    }
+    std::stringstream source;
+    source << sourceFile.rdbuf();
+    compiled = level_pack::compile(source.str());
+    data = compiled.data();
+    dataSize = compiled.size();
+    if (!validate())
+    {
+        throw std::runtime_error("Invalid level pack compiled from: " + sourcePath);
+    }
+}
+
+LevelPack::LevelPack(std::vector<std::byte>&& compiled) :
+    compiled(std::move(compiled))
+{
+    data = this->compiled.data();
+    dataSize = this->compiled.size();
+    if (!validate())
+    {
+        throw std::runtime_error("Invalid level pack");
+    }
+}
+
+bool LevelPack::validate()
+{
+    level_pack::Header header;
+    if (dataSize < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != level_pack::magic || header.version != level_pack::version || header.numLevels == 0
+        || sizeof(header) + static_cast<uint64_t>(header.numLevels) * sizeof(level_pack::Level) > dataSize
+        || !sectionFits(header.stringTableOffset, header.stringTableSize, dataSize) || header.stringTableOffset % level_pack::sectionAlignment != 0)
+    {
+        return false;
+    }
+
+    numLevels = header.numLevels;
+    strings = reinterpret_cast<const char*>(data + header.stringTableOffset);
+    stringTableSize = header.stringTableSize;
+    for (uint32_t i = 0; i < numLevels; ++i)
+    {
+        const auto& level = this->level(i);
+        const bool aligned = level.solidOffset % level_pack::sectionAlignment == 0 && level.spawnsOffset % level_pack::sectionAlignment == 0 && level.textsOffset % level_pack::sectionAlignment == 0;
+        if (!aligned || level.width == 0 || level.height == 0
+            || !sectionFits(level.solidOffset, (static_cast<uint64_t>(level.width) * level.height + 7) / 8, dataSize)
+            || !sectionFits(level.spawnsOffset, static_cast<uint64_t>(level.numSpawns) * sizeof(level_pack::Spawn), dataSize)
+            || !sectionFits(level.textsOffset, static_cast<uint64_t>(level.numTexts) * sizeof(level_pack::Text), dataSize))
+        {
+            return false;
+        }
+        for (const auto& spawn : spawns(level))
+        {
+            if (spawn.kind >= level_pack::NumSpawnKinds || spawn.x >= level.width || spawn.y >= level.height)
+            {
+                return false;
+            }
+        }
+        const auto* texts = reinterpret_cast<const level_pack::Text*>(data + level.textsOffset);
+        for (uint32_t j = 0; j < level.numTexts; ++j)
+        {
+            if (static_cast<uint64_t>(texts[j].offset) + texts[j].length > stringTableSize)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const level_pack::Level& LevelPack::level(const uint32_t index) const
+{
+    return reinterpret_cast<const level_pack::Level*>(data + sizeof(level_pack::Header))[index];
+}
+
+bool LevelPack::solid(const level_pack::Level& level, const uint32_t x, const uint32_t y) const
+{
+    const uint32_t bit = y * level.width + x;
+    return (std::to_integer<uint32_t>(data[level.solidOffset + bit / 8]) >> (bit % 8)) & 1;
+}
+
+std::span<const level_pack::Spawn> LevelPack::spawns(const level_pack::Level& level) const
+{
+    return { reinterpret_cast<const level_pack::Spawn*>(data + level.spawnsOffset), level.numSpawns };
+}
+
+std::string_view LevelPack::text(const level_pack::Level& level, const uint32_t index) const
+{
+    const auto& text = reinterpret_cast<const level_pack::Text*>(data + level.textsOffset)[index];
+    return { strings + text.offset, text.length };
+}
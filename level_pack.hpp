@@ -0,0 +1,114 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Levels are written in a text format and compiled into a flat binary pack, by the levelpack tool at build time or by
+// LevelPack when the pack is missing or older than the text.
+//
+// Text format, one level after another:
+//     # comment
+//     level <gubgubs needed to open the door>
+//     text <line shown in the corner>
+//     <map rows, all of the same width>
+// Map cells: X wall, _ floor, P player, E enemy, F friendly, T patrol point, D door.
+//
+// Pack layout: Header, Level[numLevels], then each level's solid bitmap (row major, one bit per cell), Spawn[numSpawns]
+// and Text[numTexts], then the string table. All offsets are from the start of the file and 8 byte aligned.
+namespace level_pack
+{
+    constexpr uint32_t magic = 0x4B41504C; // "LPAK"
+    constexpr uint32_t version = 1;
+    constexpr uint64_t sectionAlignment = 8;
+
+    // the map characters, spawns are sorted in this order and row major within a kind
+    enum SpawnKind : uint32_t
+    {
+        Player,
+        Enemy,
+        Friendly,
+        PatrolPoint,
+        Door,
+        NumSpawnKinds,
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t numLevels;
+        uint32_t stringTableSize;
+        uint64_t stringTableOffset;
+    };
+
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t entitiesNeeded;
+        uint32_t numSpawns;
+        uint32_t numTexts;
+        uint32_t padding;
+        uint64_t solidOffset;
+        uint64_t spawnsOffset;
+        uint64_t textsOffset;
+    };
+
+    struct Spawn
+    {
+        uint32_t kind;
+        uint16_t x;
+        uint16_t y;
+    };
+
+    struct Text
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static_assert(sizeof(Header) == 24);
+    static_assert(sizeof(Level) == 48);
+    static_assert(sizeof(Spawn) == 8);
+    static_assert(sizeof(Text) == 8);
+
+    // Throws std::runtime_error naming the line on malformed input.
+    std::vector<std::byte> compile(const std::string_view source);
+}
+
+// Read only view of a level pack, mapped from disk or compiled from the text in memory.
+struct LevelPack
+{
+    // Maps packPath unless sourcePath is newer or the pack is unusable, falling back to compiling sourcePath.
+    explicit LevelPack(const std::string& packPath, const std::string& sourcePath);
+    // takes the output of level_pack::compile, for levels generated at runtime
+    explicit LevelPack(std::vector<std::byte>&& compiled);
+
+    LevelPack(const LevelPack&) = delete;
+    LevelPack& operator=(const LevelPack&) = delete;
+
+    uint32_t size() const { return numLevels; }
+    const level_pack::Level& level(const uint32_t index) const;
+    bool solid(const level_pack::Level& level, const uint32_t x, const uint32_t y) const;
+    std::span<const level_pack::Spawn> spawns(const level_pack::Level& level) const;
+    std::string_view text(const level_pack::Level& level, const uint32_t index) const;
+
+    std::optional<eng::MappedFile> file;
+    std::vector<std::byte> compiled;
+    const std::byte* data = nullptr;
+    size_t dataSize = 0;
+    uint32_t numLevels = 0;
+    const char* strings = nullptr;
+    uint32_t stringTableSize = 0;
+
+private:
+    // checks every offset once, so the accessors don't have to
+    bool validate();
+};
@@ -0,0 +1,46 @@
+// Offline level pack builder: levelpack <output> <level source>
+
+#include "level_pack.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <output> <level source>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream sourceFile(argv[2], std::ios::binary);
+    if (!sourceFile)
+    {
+        std::cerr << "Failed to open level source: " << argv[2] << std::endl;
+        return 1;
+    }
+    std::stringstream source;
+    source << sourceFile.rdbuf();
+
+    std::vector<std::byte> pack;
+    try
+    {
+        pack = level_pack::compile(source.str());
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << argv[2] << ": " << error.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream output(argv[1], std::ios::binary);
+    output.write(reinterpret_cast<const char*>(pack.data()), pack.size());
+    if (!output)
+    {
+        std::cerr << "Failed to write level pack: " << argv[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "mip_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+static float srgbToLinear(const float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb(const float value)
+{
+    const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+static const std::array<float, 256> srgbToLinearTable = []
+{
+    std::array<float, 256> table;
+    for (uint32_t i = 0; i < table.size(); ++i)
+    {
+        table[i] = srgbToLinear(i / 255.0f);
+    }
+    return table;
+}();
+
+uint32_t eng::fullMipLevels(const uint32_t width, const uint32_t height)
+{
+    return std::bit_width(std::max({ width, height, 1u }));
+}
+
+size_t eng::mipChainSize(const uint32_t width, const uint32_t height, const uint32_t mipLevels, const uint32_t bytesPerPixel)
+{
+    size_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; ++level)
+    {
+        size += static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * bytesPerPixel;
+    }
+    return size;
+}
+
+void eng::generateMipChain(std::byte* data, const uint32_t width, const uint32_t height, const uint32_t mipLevels)
+{
+    auto source = reinterpret_cast<uint8_t*>(data);
+    uint32_t sourceWidth = width;
+    uint32_t sourceHeight = height;
+    for (uint32_t level = 1; level < mipLevels; ++level)
+    {
+        const uint32_t levelWidth = std::max(sourceWidth / 2, 1u);
+        const uint32_t levelHeight = std::max(sourceHeight / 2, 1u);
+        uint8_t* destination = source + static_cast<size_t>(sourceWidth) * sourceHeight * 4;
+
+        for (uint32_t y = 0; y < levelHeight; ++y)
+        {
+            for (uint32_t x = 0; x < levelWidth; ++x)
+            {
+                float color[3] = {};
+                float unweightedColor[3] = {};
+                float alpha = 0.0f;
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    const uint32_t sourceX = std::min(2 * x + (i & 1), sourceWidth - 1);
+                    const uint32_t sourceY = std::min(2 * y + (i >> 1), sourceHeight - 1);
+                    const uint8_t* texel = source + (static_cast<size_t>(sourceY) * sourceWidth + sourceX) * 4;
+                    const float texelAlpha = texel[3] / 255.0f;
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        color[c] += srgbToLinearTable[texel[c]] * texelAlpha;
+                        unweightedColor[c] += srgbToLinearTable[texel[c]];
+                    }
+                    alpha += texelAlpha;
+                }
+
+                uint8_t* texel = destination + (static_cast<size_t>(y) * levelWidth + x) * 4;
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    texel[c] = linearToSrgb(alpha > 0.0f ? color[c] / alpha : unweightedColor[c] / 4.0f);
+                }
+                texel[3] = static_cast<uint8_t>(std::clamp(alpha / 4.0f * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+
+        source = destination;
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+}
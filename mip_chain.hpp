@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eng
+{
+    uint32_t fullMipLevels(const uint32_t width, const uint32_t height);
+
+    // Size of mip levels [0, mipLevels) stored back to back, largest first.
+    size_t mipChainSize(const uint32_t width, const uint32_t height, const uint32_t mipLevels, const uint32_t bytesPerPixel);
+
+    // data holds level 0 of an sRGB RGBA8 image followed by room for the remaining levels. Each level is box filtered
+    // from the previous one in linear space with alpha weighting, so transparent texels don't darken sprite outlines.
+    void generateMipChain(std::byte* data, const uint32_t width, const uint32_t height, const uint32_t mipLevels);
+}
@@ -0,0 +1,89 @@
+#include "pipeline_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using eng::PipelineCache;
+
+static std::string getFilePath(const vk::raii::PhysicalDevice& physicalDevice, const std::string& directory)
+{
+    if (directory.empty())
+    {
+        return {};
+    }
+    static constexpr char hexDigits[] = "0123456789abcdef";
+    std::string name = "pipelines-";
+    for (const uint8_t byte : physicalDevice.getProperties().pipelineCacheUUID)
+    {
+        name += hexDigits[byte >> 4];
+        name += hexDigits[byte & 0xF];
+    }
+    name += ".cache";
+    return (std::filesystem::path(directory) / name).string();
+}
+
+// Some drivers don't validate the data they are given, so the header is checked against the device first.
+static std::vector<char> loadCacheData(const vk::raii::PhysicalDevice& physicalDevice, const std::string& filePath)
+{
+    std::vector<char> data;
+    if (auto fileStream = std::ifstream(filePath, std::ios::binary); !filePath.empty() && fileStream)
+    {
+        data.assign(std::istreambuf_iterator<char>(fileStream), {});
+    }
+
+    const auto properties = physicalDevice.getProperties();
+    vk::PipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header))
+    {
+        return {};
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.headerSize < sizeof(header) || header.headerVersion != vk::PipelineCacheHeaderVersion::eOne
+            || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+            || std::memcmp(header.pipelineCacheUUID.data(), properties.pipelineCacheUUID.data(), vk::UuidSize) != 0)
+    {
+        return {};
+    }
+    return data;
+}
+
+PipelineCache::PipelineCache(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const std::string& directory) :
+    filePath(getFilePath(physicalDevice, directory)),
+    cache(nullptr)
+{
+    const auto data = loadCacheData(physicalDevice, filePath);
+    cache = vk::raii::PipelineCache(device, vk::PipelineCacheCreateInfo {
+            .initialDataSize = data.size(),
+            .pInitialData = data.data(),
+        });
+}
+
+PipelineCache::~PipelineCache()
+{
+    if (filePath.empty())
+    {
+        return;
+    }
+    // failing to save only costs the next start its warm cache, so errors are not reported
+    try
+    {
+        const auto data = cache.getData();
+        const auto temporaryPath = filePath + ".tmp";
+        {
+            std::ofstream fileStream(temporaryPath, std::ios::binary | std::ios::trunc);
+            fileStream.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if (!fileStream)
+            {
+                return;
+            }
+        }
+        // written next to it and renamed, so a crash while saving can't leave a truncated cache behind
+        std::filesystem::rename(temporaryPath, filePath);
+    }
+    catch (...)
+    {
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "vulkan_includes.hpp"
+
+#include <string>
+
+namespace eng
+{
+    // A VkPipelineCache persisted in directory, one file per pipelineCacheUUID so drivers and devices never see
+    // each other's data. The file is read on construction and written back on destruction. A missing or mismatching
+    // file just starts out empty. An empty directory disables persistence.
+    struct PipelineCache
+    {
+        explicit PipelineCache(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const std::string& directory);
+        ~PipelineCache();
+
+        PipelineCache(const PipelineCache&) = delete;
+        PipelineCache& operator=(const PipelineCache&) = delete;
+
+        const std::string filePath;
+        vk::raii::PipelineCache cache;
+    };
+}
@@ -0,0 +1,152 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+using eng::Profiler;
+
+std::atomic<Profiler*> Profiler::active_ = nullptr;
+
+// small ids in order of the threads' first scope, the trace viewer shows one row per id
+static uint32_t threadIndex()
+{
+    static std::atomic<uint32_t> nextIndex = 0;
+    thread_local const uint32_t index = nextIndex++;
+    return index;
+}
+
+// the GPU gets a row of its own
+static constexpr uint32_t gpuThread = 1000;
+
+Profiler::Profiler(const std::string& traceFilePath) :
+    traceFilePath(traceFilePath),
+    startTime(std::chrono::steady_clock::now()),
+    lastFrameEnd(startTime)
+{
+    Profiler* expected = nullptr;
+    if (!active_.compare_exchange_strong(expected, this, std::memory_order_acq_rel))
+    {
+        throw std::runtime_error("Only one profiler can be active at a time");
+    }
+}
+
+Profiler::~Profiler()
+{
+    active_.store(nullptr, std::memory_order_release);
+    if (!traceFilePath.empty())
+    {
+        writeTrace();
+    }
+}
+
+void Profiler::recordScope(const char* name, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end)
+{
+    const uint32_t thread = threadIndex();
+    std::lock_guard lock(mutex);
+    if (events.size() < maxEvents)
+    {
+        events.push_back(Event {
+                .name = name,
+                .thread = thread,
+                .begin = begin,
+                .duration = end - begin,
+            });
+    }
+}
+
+void Profiler::endFrame(const FrameStats& stats)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock(mutex);
+    last = stats;
+    last.frameTime = std::chrono::duration<double>(now - lastFrameEnd).count();
+    lastFrameEnd = now;
+    if (frames.size() < maxEvents)
+    {
+        frames.emplace_back(now, last);
+    }
+    if (stats.gpuTime > 0 && events.size() < maxEvents)
+    {
+        events.push_back(Event {
+                .name = "gpu",
+                .thread = gpuThread,
+                .begin = stats.gpuSubmitTime,
+                .duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(stats.gpuTime)),
+            });
+    }
+}
+
+eng::FrameStats Profiler::lastFrame() const
+{
+    std::lock_guard lock(mutex);
+    return last;
+}
+
+std::vector<Profiler::ScopeStats> Profiler::scopeStats() const
+{
+    std::vector<ScopeStats> stats;
+    std::lock_guard lock(mutex);
+    for (const auto& event : events)
+    {
+        if (event.thread == gpuThread)
+        {
+            continue;
+        }
+        auto it = std::find_if(stats.begin(), stats.end(), [&](const ScopeStats& scope) { return std::string_view(scope.name) == event.name; });
+        if (it == stats.end())
+        {
+            it = stats.insert(stats.end(), ScopeStats { .name = event.name, .count = 0, .totalTime = 0, .maxTime = 0 });
+        }
+        const double time = std::chrono::duration<double>(event.duration).count();
+        ++it->count;
+        it->totalTime += time;
+        it->maxTime = std::max(it->maxTime, time);
+    }
+    return stats;
+}
+
+static void writeString(std::ofstream& output, const char* string)
+{
+    output << '"';
+    for (; *string; ++string)
+    {
+        if (*string == '"' || *string == '\\')
+        {
+            output << '\\';
+        }
+        output << *string;
+    }
+    output << '"';
+}
+
+void Profiler::writeTrace() const
+{
+    std::ofstream output(traceFilePath, std::ios::trunc);
+    if (!output)
+    {
+        return;
+    }
+    const auto microseconds = [](const std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        };
+
+    std::lock_guard lock(mutex);
+    output << "{\"traceEvents\":[\n";
+    output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << gpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const auto& event : events)
+    {
+        output << ",\n{\"name\":";
+        writeString(output, event.name);
+        output << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread << ",\"ts\":" << microseconds(event.begin - startTime) << ",\"dur\":" << microseconds(event.duration) << '}';
+    }
+    for (const auto& [time, stats] : frames)
+    {
+        output << ",\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(time - startTime)
+            << ",\"args\":{\"frameMs\":" << stats.frameTime * 1000 << ",\"waitMs\":" << stats.waitTime * 1000 << ",\"gpuMs\":" << stats.gpuTime * 1000
+            << ",\"instances\":" << stats.numInstances << ",\"uploadedBytes\":" << stats.bytesUploaded << "}}";
+    }
+    output << "\n]}\n";
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace eng
+{
+    struct FrameStats
+    {
+        // render thread time since the previous frame
+        double frameTime = 0;
+        // blocked on the GPU for the frame's resources or a swapchain image
+        double waitTime = 0;
+        // between the timestamps around rendering, of the last frame that used the same resources, 0 without timestamps
+        double gpuTime = 0;
+        std::chrono::steady_clock::time_point gpuSubmitTime;
+        uint32_t numInstances = 0;
+        uint64_t bytesUploaded = 0;
+    };
+
+    // Collects ProfileScopes from every thread and the renderer's FrameStats while it exists, at most one at a time.
+    // Written as a Chrome trace (chrome://tracing, ui.perfetto.dev) when destroyed, unless traceFilePath is empty.
+    class Profiler
+    {
+    public:
+        // bounds the memory of long sessions, later scopes and frames are left out of the trace
+        static constexpr size_t maxEvents = 1 << 20;
+
+        explicit Profiler(const std::string& traceFilePath);
+        ~Profiler();
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // nullptr when nothing is being profiled
+        static Profiler* active() { return active_.load(std::memory_order_acquire); }
+
+        void recordScope(const char* name, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end);
+        // render thread, once per frame
+        void endFrame(const FrameStats& stats);
+        FrameStats lastFrame() const;
+
+        struct ScopeStats
+        {
+            const char* name;
+            uint32_t count;
+            // seconds
+            double totalTime;
+            double maxTime;
+        };
+
+        // totals of the recorded scopes by name, in order of their first occurrence
+        std::vector<ScopeStats> scopeStats() const;
+
+    private:
+        struct Event
+        {
+            const char* name;
+            uint32_t thread;
+            std::chrono::steady_clock::time_point begin;
+            std::chrono::steady_clock::duration duration;
+        };
+
+        void writeTrace() const;
+
+        static std::atomic<Profiler*> active_;
+
+        const std::string traceFilePath;
+        const std::chrono::steady_clock::time_point startTime;
+        mutable std::mutex mutex;
+        std::vector<Event> events;
+        std::vector<std::pair<std::chrono::steady_clock::time_point, FrameStats>> frames;
+        FrameStats last;
+        std::chrono::steady_clock::time_point lastFrameEnd;
+    };
+
+    // Times its own lifetime into the active Profiler, costs an atomic load when there is none. name has to outlive the
+    // profiler, a string literal usually.
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const char* name) :
+            name(name),
+            profiler(Profiler::active())
+        {
+            if (profiler)
+            {
+                begin = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ProfileScope()
+        {
+            if (profiler)
+            {
+                profiler->recordScope(name, begin, std::chrono::steady_clock::now());
+            }
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        const char* const name;
+        Profiler* const profiler;
+        std::chrono::steady_clock::time_point begin;
+    };
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// For every cell and each of the four directions, how many cells a straight scan visits before it is stopped. Walls
+// block the scan before the cell, stops (cells with a solid occupant) end it after the cell, the map edge ends it too.
+// Directions are indexed Up, Left, Down, Right with y growing downwards.
+struct RayDistanceField
+{
+    constexpr static std::array<std::array<int, 2>, 4> directionDeltas { { { 0, -1 }, { -1, 0 }, { 0, 1 }, { 1, 0 } } };
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> walls;
+    std::vector<uint8_t> stops;
+    std::array<std::vector<uint32_t>, 4> distances;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(width, height, walls, stops, distances);
+    }
+
+    void reset(const uint32_t width, const uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        walls.assign(width * height, 0);
+        stops.assign(width * height, 0);
+        for (auto& directionDistances : distances)
+        {
+            directionDistances.assign(width * height, 0);
+        }
+    }
+
+    // walls only change while loading, so this leaves the distances to rebuild()
+    void setWall(const uint32_t x, const uint32_t y, const bool wall)
+    {
+        walls[y * width + x] = wall;
+    }
+
+    // only the row and column through the cell can change
+    void setStop(const uint32_t x, const uint32_t y, const bool stop)
+    {
+        if (stops[y * width + x] != stop)
+        {
+            stops[y * width + x] = stop;
+            updateRow(y);
+            updateColumn(x);
+        }
+    }
+
+    void rebuild()
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            updateRow(y);
+        }
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            updateColumn(x);
+        }
+    }
+
+    uint32_t distance(const uint32_t x, const uint32_t y, const uint32_t direction) const
+    {
+        return distances[direction][y * width + x];
+    }
+
+    // whether the last cell visited by the scan has a stop in it, as opposed to being in front of a wall or the edge
+    bool endsAtStop(const uint32_t x, const uint32_t y, const uint32_t direction) const
+    {
+        const uint32_t distance = this->distance(x, y, direction);
+        const auto [dx, dy] = directionDeltas[direction];
+        return distance > 0 && stops[(y + distance * dy) * width + x + distance * dx];
+    }
+
+private:
+    // a cell's distance is the one of the next cell in the direction plus one, so each line is filled from its far end
+    uint32_t step(const uint32_t next, const uint32_t nextDistance) const
+    {
+        return walls[next] ? 0 : stops[next] ? 1 : nextDistance + 1;
+    }
+
+    void updateRow(const uint32_t y)
+    {
+        auto& left = distances[1];
+        auto& right = distances[3];
+        const uint32_t row = y * width;
+        left[row] = 0;
+        for (uint32_t x = 1; x < width; ++x)
+        {
+            left[row + x] = step(row + x - 1, left[row + x - 1]);
+        }
+        right[row + width - 1] = 0;
+        for (uint32_t x = width - 1; x-- > 0;)
+        {
+            right[row + x] = step(row + x + 1, right[row + x + 1]);
+        }
+    }
+
+    void updateColumn(const uint32_t x)
+    {
+        auto& up = distances[0];
+        auto& down = distances[2];
+        up[x] = 0;
+        for (uint32_t y = 1; y < height; ++y)
+        {
+            up[y * width + x] = step((y - 1) * width + x, up[(y - 1) * width + x]);
+        }
+        down[(height - 1) * width + x] = 0;
+        for (uint32_t y = height - 1; y-- > 0;)
+        {
+            down[y * width + x] = step((y + 1) * width + x, down[(y + 1) * width + x]);
+        }
+    }
+};
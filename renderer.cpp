@@ -1,13 +1,53 @@
 #include "renderer.hpp"
 #include "engine.hpp"
+#include "gpu_instance.hpp"
+#include "gpu_timeline.hpp"
+#include "instance_store.hpp"
 #include "swapchain.hpp"
+#include "thread_pool.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
 #include <fstream>
+#include <future>
+#include <numeric>
 
 using namespace eng;
 
+struct PushConstants
+{
+    glm::vec2 positionOffset;
+};
+
+struct CullPushConstants
+{
+    glm::vec2 positionOffset;
+    uint32_t firstInstance;
+    uint32_t numInstances;
+    uint32_t firstCommand;
+};
+
+struct TilePushConstants
+{
+    glm::vec2 positionOffset;
+    glm::vec2 position;
+    uint32_t width;
+    uint32_t height;
+    uint32_t backgroundTextureIndex;
+};
+
+// must match local_size_x in cull.cs.glsl
+static constexpr uint32_t cullGroupSize = 64;
+
+static uint32_t numCullGroups(const uint32_t numInstances)
+{
+    return (numInstances + cullGroupSize - 1) / cullGroupSize;
+}
+
 template<typename DescriptorSetBindingsArrayType>
 static vk::raii::DescriptorSetLayout createDescriptorSetLayout(const vk::raii::Device& device, DescriptorSetBindingsArrayType&& bindings)
 {
@@ -17,15 +57,95 @@ static vk::raii::DescriptorSetLayout createDescriptorSetLayout(const vk::raii::D
         });
 }
 
-static std::vector<vk::raii::DescriptorSetLayout> createDescriptorSetLayouts(const vk::raii::Device& device, const uint32_t numBindlessTextures)
+// indexed by eng::Sampler
+static const std::array<vk::SamplerCreateInfo, Renderer::numSamplers> samplerCreateInfos = {
+    // Sampler::Nearest, still picks the nearest mip when minified to avoid shimmer
+    vk::SamplerCreateInfo {
+        .magFilter = vk::Filter::eNearest,
+        .minFilter = vk::Filter::eNearest,
+        .mipmapMode = vk::SamplerMipmapMode::eNearest,
+        .addressModeU = vk::SamplerAddressMode::eRepeat,
+        .addressModeV = vk::SamplerAddressMode::eRepeat,
+        .addressModeW = vk::SamplerAddressMode::eRepeat,
+        .maxLod = vk::LodClampNone,
+    },
+    // Sampler::Linear, clamped so atlas and sprite edges don't bleed over from the opposite side
+    vk::SamplerCreateInfo {
+        .magFilter = vk::Filter::eLinear,
+        .minFilter = vk::Filter::eLinear,
+        .mipmapMode = vk::SamplerMipmapMode::eLinear,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .maxLod = vk::LodClampNone,
+    },
+};
+
+static std::vector<vk::raii::Sampler> createSamplers(const vk::raii::Device& device)
+{
+    std::vector<vk::raii::Sampler> samplers;
+    samplers.reserve(samplerCreateInfos.size());
+    for (const auto& samplerCreateInfo : samplerCreateInfos)
+    {
+        samplers.emplace_back(device, samplerCreateInfo);
+    }
+    return samplers;
+}
+
+static std::vector<vk::raii::DescriptorSetLayout> createDescriptorSetLayouts(const vk::raii::Device& device, const uint32_t numTextureDescriptors, const bool bindlessSupported, const std::vector<vk::raii::Sampler>& samplers)
 {
+    std::vector<vk::Sampler> immutableSamplers;
+    for (const auto& sampler : samplers)
+    {
+        immutableSamplers.push_back(sampler);
+    }
+
+    const std::array textureBindings {
+        vk::DescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eSampledImage,
+            .descriptorCount = numTextureDescriptors,
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+        },
+        vk::DescriptorSetLayoutBinding {
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eSampler,
+            .descriptorCount = static_cast<uint32_t>(immutableSamplers.size()),
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+            .pImmutableSamplers = immutableSamplers.data(),
+        },
+    };
+    // with bindless the texture slots only need descriptors while in use and can be written while frames are in flight
+    const std::array<vk::DescriptorBindingFlags, 2> textureBindingFlags {
+        vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+        vk::DescriptorBindingFlags {},
+    };
+    const vk::DescriptorSetLayoutBindingFlagsCreateInfo textureBindingFlagsCreateInfo {
+        .bindingCount = static_cast<uint32_t>(textureBindingFlags.size()),
+        .pBindingFlags = textureBindingFlags.data(),
+    };
+
     std::vector<vk::raii::DescriptorSetLayout> descriptorSetLayouts;
+    descriptorSetLayouts.push_back(vk::raii::DescriptorSetLayout(device, vk::DescriptorSetLayoutCreateInfo {
+                .pNext = bindlessSupported ? &textureBindingFlagsCreateInfo : nullptr,
+                .flags = bindlessSupported ? vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool : vk::DescriptorSetLayoutCreateFlags {},
+                .bindingCount = static_cast<uint32_t>(textureBindings.size()),
+                .pBindings = textureBindings.data(),
+            }));
     descriptorSetLayouts.push_back(createDescriptorSetLayout(device, std::array {
                 vk::DescriptorSetLayoutBinding {
                     .binding = 0,
-                    .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-                    .descriptorCount = numBindlessTextures,
-                    .stageFlags = vk::ShaderStageFlagBits::eFragment,
+                    .descriptorType = vk::DescriptorType::eUniformBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                },
+            }));
+    descriptorSetLayouts.push_back(createDescriptorSetLayout(device, std::array {
+                vk::DescriptorSetLayoutBinding {
+                    .binding = 0,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eVertex,
                 }
             }));
     descriptorSetLayouts.push_back(createDescriptorSetLayout(device, std::array {
@@ -33,7 +153,25 @@ static std::vector<vk::raii::DescriptorSetLayout> createDescriptorSetLayouts(con
                     .binding = 0,
                     .descriptorType = vk::DescriptorType::eUniformBuffer,
                     .descriptorCount = 1,
-                    .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                    .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                },
+                vk::DescriptorSetLayoutBinding {
+                    .binding = 1,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                },
+                vk::DescriptorSetLayoutBinding {
+                    .binding = 2,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                },
+                vk::DescriptorSetLayoutBinding {
+                    .binding = 3,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eCompute,
                 },
             }));
     descriptorSetLayouts.push_back(createDescriptorSetLayout(device, std::array {
@@ -41,25 +179,20 @@ static std::vector<vk::raii::DescriptorSetLayout> createDescriptorSetLayouts(con
                     .binding = 0,
                     .descriptorType = vk::DescriptorType::eStorageBuffer,
                     .descriptorCount = 1,
-                    .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                    .stageFlags = vk::ShaderStageFlagBits::eFragment,
                 }
             }));
 
     return descriptorSetLayouts;
 }
 
-static vk::raii::PipelineLayout createPipelineLayout(const vk::raii::Device& device, const std::vector<vk::raii::DescriptorSetLayout>& descriptorSetLayouts)
+static vk::raii::PipelineLayout createPipelineLayout(const vk::raii::Device& device, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts, const vk::PushConstantRange& pushConstantRange)
 {
-    std::vector<vk::DescriptorSetLayout> rawDescriptorSetLayouts;
-    rawDescriptorSetLayouts.reserve(descriptorSetLayouts.size());
-    for (const auto& descriptorSetLayout : descriptorSetLayouts)
-    {
-        rawDescriptorSetLayouts.push_back(*descriptorSetLayout);
-    }
-
     return vk::raii::PipelineLayout(device, vk::PipelineLayoutCreateInfo {
             .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-            .pSetLayouts = rawDescriptorSetLayouts.data(),
+            .pSetLayouts = descriptorSetLayouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
         });
 }
 
@@ -76,10 +209,48 @@ static vk::raii::ShaderModule loadShaderModule(const vk::raii::Device& device, c
     throw std::runtime_error("Failed to open file: " + filePath);
 }
 
-static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, const vk::Format colorAttachmentFormat, vk::PipelineLayout&& layout)
+static bool isSrgbFormat(const vk::Format format)
+{
+    switch (format)
+    {
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eB8G8R8A8Srgb:
+        case vk::Format::eA8B8G8R8SrgbPack32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// matches the constant_id declarations in shaders/color.glsl
+struct FragmentSpecializationConstants
+{
+    vk::Bool32 srgbAttachment;
+};
+
+static constexpr std::array fragmentSpecializationMapEntries = {
+    vk::SpecializationMapEntry {
+        .constantID = 0,
+        .offset = offsetof(FragmentSpecializationConstants, srgbAttachment),
+        .size = sizeof(vk::Bool32),
+    },
+};
+
+static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const vk::raii::PipelineCache& pipelineCache, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, const vk::Format colorAttachmentFormat, const bool blendEnable, vk::PipelineLayout&& layout)
 {
     auto vertexShaderModule = loadShaderModule(device, vertexShaderPath);
     auto fragmentShaderModule = loadShaderModule(device, fragmentShaderPath);
+
+    const FragmentSpecializationConstants fragmentSpecializationConstants {
+        .srgbAttachment = isSrgbFormat(colorAttachmentFormat) ? vk::True : vk::False,
+    };
+    const vk::SpecializationInfo fragmentSpecializationInfo {
+        .mapEntryCount = fragmentSpecializationMapEntries.size(),
+        .pMapEntries = fragmentSpecializationMapEntries.data(),
+        .dataSize = sizeof(fragmentSpecializationConstants),
+        .pData = &fragmentSpecializationConstants,
+    };
+
     const std::array stages = {
         vk::PipelineShaderStageCreateInfo {
             .stage = vk::ShaderStageFlagBits::eVertex,
@@ -90,6 +261,7 @@ static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const s
             .stage = vk::ShaderStageFlagBits::eFragment,
             .module = fragmentShaderModule,
             .pName = "main",
+            .pSpecializationInfo = &fragmentSpecializationInfo,
         }
     };
 
@@ -118,7 +290,7 @@ static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const s
 
     const std::array colorBlendAttachments = {
         vk::PipelineColorBlendAttachmentState {
-            .blendEnable = vk::True,
+            .blendEnable = blendEnable ? vk::True : vk::False,
             .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
             .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
             .colorBlendOp = vk::BlendOp::eAdd,
@@ -144,7 +316,7 @@ static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const s
         .pColorAttachmentFormats = &colorAttachmentFormat,
     };
 
-    return vk::raii::Pipeline(device, nullptr, vk::GraphicsPipelineCreateInfo {
+    return vk::raii::Pipeline(device, pipelineCache, vk::GraphicsPipelineCreateInfo {
             .pNext = &renderingInfo,
             .stageCount = stages.size(),
             .pStages = stages.data(),
@@ -160,53 +332,201 @@ static vk::raii::Pipeline createPipeline(const vk::raii::Device& device, const s
         });
 }
 
-static vk::raii::DescriptorPool createDescriptorPool(const vk::raii::Device& device, const uint32_t numBindlessTextures, const uint32_t numFramesInFlight)
+static std::vector<vk::raii::Pipeline> createInstancePipelines(const vk::raii::Device& device, const vk::raii::PipelineCache& pipelineCache, const std::string& vertexShaderPath, const std::string& fragmentShaderPath, const vk::Format colorAttachmentFormat, const vk::raii::PipelineLayout& layout)
+{
+    std::vector<vk::raii::Pipeline> pipelines;
+    pipelines.push_back(createPipeline(device, pipelineCache, vertexShaderPath, fragmentShaderPath, colorAttachmentFormat, false, *layout));
+    pipelines.push_back(createPipeline(device, pipelineCache, vertexShaderPath, fragmentShaderPath, colorAttachmentFormat, true, *layout));
+    return pipelines;
+}
+
+static vk::raii::Pipeline createCullPipeline(const vk::raii::Device& device, const vk::raii::PipelineCache& pipelineCache, const std::string& computeShaderPath, vk::PipelineLayout&& layout)
+{
+    auto computeShaderModule = loadShaderModule(device, computeShaderPath);
+
+    return vk::raii::Pipeline(device, pipelineCache, vk::ComputePipelineCreateInfo {
+            .stage = vk::PipelineShaderStageCreateInfo {
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = computeShaderModule,
+                .pName = "main",
+            },
+            .layout = layout,
+        });
+}
+
+static vk::raii::DescriptorPool createDescriptorPool(const vk::raii::Device& device, const uint32_t numTextureDescriptors, const bool bindlessSupported, const uint32_t numFramesInFlight)
 {
     const std::array poolSizes = {
-        vk::DescriptorPoolSize { vk::DescriptorType::eUniformBuffer, numFramesInFlight },
-        vk::DescriptorPoolSize { vk::DescriptorType::eCombinedImageSampler, numBindlessTextures },
-        vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, numFramesInFlight },
+        vk::DescriptorPoolSize { vk::DescriptorType::eUniformBuffer, 2 * numFramesInFlight },
+        vk::DescriptorPoolSize { vk::DescriptorType::eSampledImage, numTextureDescriptors },
+        vk::DescriptorPoolSize { vk::DescriptorType::eSampler, Renderer::numSamplers },
+        vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, 6 * numFramesInFlight },
     };
 
     return vk::raii::DescriptorPool(device, vk::DescriptorPoolCreateInfo {
-            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-            .maxSets = 1 + 2 * numFramesInFlight,
+            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | (bindlessSupported ? vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind : vk::DescriptorPoolCreateFlags {}),
+            .maxSets = 1 + 5 * numFramesInFlight,
             .poolSizeCount = poolSizes.size(),
             .pPoolSizes = poolSizes.data(),
         });
 }
 
-static vk::raii::DescriptorSet createTextureDescriptorSet(const vk::raii::Device& device, const vk::DescriptorPool& descriptorPool, const vk::DescriptorSetLayout& descriptorSetLayout, const vk::Sampler& textureSampler, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures)
+static uint32_t getNumTextureDescriptors(const uint32_t maxTextureArrays, const bool bindlessSupported)
 {
-    auto descriptorSet = std::move(device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo {
-                .descriptorPool = descriptorPool,
-                .descriptorSetCount = 1,
-                .pSetLayouts = &descriptorSetLayout,
-            }).front());
+    // without bindless the array has a fixed size so the shaders can index it with a constant bound
+    return bindlessSupported ? std::max(maxTextureArrays, 1u) : Renderer::maxNonBindlessTextureArrays;
+}
+
+// Points the slots at their images. Without bindless every slot has to hold a valid descriptor, so empty ones repeat
+// another texture, with bindless they're left alone as partially bound.
+static void writeTextureDescriptors(const vk::raii::Device& device, const vk::DescriptorSet& descriptorSet, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const std::vector<uint32_t>& slots, const uint32_t numTextureDescriptors, const bool bindlessSupported)
+{
+    vk::ImageView fallbackImageView;
+    for (const auto& texture : textures)
+    {
+        if (std::get<0>(texture))
+        {
+            fallbackImageView = *std::get<2>(texture);
+            break;
+        }
+    }
 
     std::vector<vk::DescriptorImageInfo> imageInfos;
-    imageInfos.reserve(textures.size());
-    for (auto&& [image, allocation, imageView] : textures)
+    std::vector<vk::WriteDescriptorSet> writes;
+    imageInfos.reserve(slots.size());
+    for (const uint32_t slot : slots)
     {
+        if (slot >= numTextureDescriptors)
+        {
+            throw std::runtime_error("Texture slot out of range");
+        }
+        const bool loaded = slot < textures.size() && std::get<0>(textures[slot]);
+        if (!loaded && (bindlessSupported || !fallbackImageView))
+        {
+            continue;
+        }
         imageInfos.push_back(vk::DescriptorImageInfo {
-                .sampler = textureSampler,
-                .imageView = imageView,
+                .imageView = loaded ? *std::get<2>(textures[slot]) : fallbackImageView,
                 .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
             });
+        writes.push_back(vk::WriteDescriptorSet {
+                .dstSet = descriptorSet,
+                .dstBinding = 0,
+                .dstArrayElement = slot,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eSampledImage,
+                .pImageInfo = &imageInfos.back(),
+            });
+    }
+    if (!writes.empty())
+    {
+        device.updateDescriptorSets(writes, {});
     }
+}
 
-    device.updateDescriptorSets(vk::WriteDescriptorSet {
-            .dstSet = descriptorSet,
-            .dstBinding = 0,
-            .descriptorCount = static_cast<uint32_t>(imageInfos.size()),
-            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            .pImageInfo = imageInfos.data(),
-        }, {});
+static vk::raii::DescriptorSet createTextureDescriptorSet(const vk::raii::Device& device, const vk::DescriptorPool& descriptorPool, const vk::DescriptorSetLayout& descriptorSetLayout, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const uint32_t numTextureDescriptors, const bool bindlessSupported)
+{
+    auto descriptorSet = std::move(device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo {
+                .descriptorPool = descriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &descriptorSetLayout,
+            }).front());
+
+    std::vector<uint32_t> slots(bindlessSupported ? std::min<size_t>(textures.size(), numTextureDescriptors) : numTextureDescriptors);
+    std::iota(slots.begin(), slots.end(), 0);
+    writeTextureDescriptors(device, descriptorSet, textures, slots, numTextureDescriptors, bindlessSupported);
 
     return descriptorSet;
 }
 
-static std::vector<FrameData> createFrameData(const vk::raii::Device& device, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const vk::raii::DescriptorPool& descriptorPool, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts, const uint32_t numFramesInFlight)
+static std::tuple<vma::UniqueBuffer, vma::UniqueAllocation, vma::AllocationInfo> createInstanceBuffer(const vma::Allocator& allocator, const uint32_t instanceCapacity)
+{
+    vma::AllocationInfo allocationInfo;
+    auto [buffer, allocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
+            .size = instanceCapacity * sizeof(GpuInstance),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+        }, vma::AllocationCreateInfo {
+            .flags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+            .usage = vma::MemoryUsage::eAuto,
+        }, allocationInfo);
+    return { std::move(buffer), std::move(allocation), allocationInfo };
+}
+
+static std::tuple<vma::UniqueBuffer, vma::UniqueAllocation, vma::UniqueBuffer, vma::UniqueAllocation> createCullBuffers(const vma::Allocator& allocator, const uint32_t instanceCapacity)
+{
+    auto [culledInstanceBuffer, culledInstanceBufferAllocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
+            .size = instanceCapacity * sizeof(GpuInstance),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+        }, vma::AllocationCreateInfo {
+            .usage = vma::MemoryUsage::eAutoPreferDevice,
+        });
+
+    // one draw per cull group, and the retained range and each layer can end in a partial group
+    auto [indirectBuffer, indirectBufferAllocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
+            .size = (instanceCapacity / cullGroupSize + 1 + SceneInterface::numInstanceLayers) * sizeof(vk::DrawIndirectCommand),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+        }, vma::AllocationCreateInfo {
+            .usage = vma::MemoryUsage::eAutoPreferDevice,
+        });
+
+    return { std::move(culledInstanceBuffer), std::move(culledInstanceBufferAllocation), std::move(indirectBuffer), std::move(indirectBufferAllocation) };
+}
+
+static void writeInstanceDescriptorSets(const vk::raii::Device& device, const FrameData& frame)
+{
+    const std::array bufferInfos {
+        vk::DescriptorBufferInfo {
+            .buffer = *frame.uniformBuffer,
+            .range = vk::WholeSize,
+        },
+        vk::DescriptorBufferInfo {
+            .buffer = *frame.instanceBuffer,
+            .range = vk::WholeSize,
+        },
+        vk::DescriptorBufferInfo {
+            .buffer = *frame.culledInstanceBuffer,
+            .range = vk::WholeSize,
+        },
+        vk::DescriptorBufferInfo {
+            .buffer = *frame.indirectBuffer,
+            .range = vk::WholeSize,
+        },
+    };
+
+    std::vector<vk::WriteDescriptorSet> writes {
+        vk::WriteDescriptorSet {
+            .dstSet = frame.descriptorSets[1],
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &bufferInfos[1],
+        },
+    };
+    if (*frame.culledInstanceBuffer)
+    {
+        writes.push_back(vk::WriteDescriptorSet {
+                .dstSet = frame.descriptorSets[2],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &bufferInfos[2],
+            });
+        for (uint32_t binding = 0; binding < bufferInfos.size(); ++binding)
+        {
+            writes.push_back(vk::WriteDescriptorSet {
+                    .dstSet = frame.descriptorSets[3],
+                    .dstBinding = binding,
+                    .descriptorCount = 1,
+                    .descriptorType = binding == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo = &bufferInfos[binding],
+                });
+        }
+    }
+
+    device.updateDescriptorSets(writes, {});
+}
+
+static std::vector<FrameData> createFrameData(const vk::raii::Device& device, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const vk::raii::DescriptorPool& descriptorPool, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts, const uint32_t numFramesInFlight, const uint32_t instanceCapacity, const bool gpuCulling, const bool timestamps, const uint32_t numBatchCommandBuffers)
 {
     std::vector<FrameData> frameData;
     frameData.reserve(numFramesInFlight);
@@ -224,6 +544,21 @@ static std::vector<FrameData> createFrameData(const vk::raii::Device& device, co
                 .commandBufferCount = 1,
             });
 
+        std::vector<vk::raii::CommandPool> batchCommandPools;
+        std::vector<vk::raii::CommandBuffer> batchCommandBuffers;
+        for (uint32_t batch = 0; batch < numBatchCommandBuffers; ++batch)
+        {
+            auto& batchCommandPool = batchCommandPools.emplace_back(device, vk::CommandPoolCreateInfo {
+                    .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                    .queueFamilyIndex = queueFamilyIndex,
+                });
+            batchCommandBuffers.push_back(std::move(vk::raii::CommandBuffers(device, vk::CommandBufferAllocateInfo {
+                    .commandPool = batchCommandPool,
+                    .level = vk::CommandBufferLevel::eSecondary,
+                    .commandBufferCount = 1,
+                }).front()));
+        }
+
         vk::raii::DescriptorSets descriptorSets(device, vk::DescriptorSetAllocateInfo {
                 .descriptorPool = descriptorPool,
                 .descriptorSetCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
@@ -239,51 +574,35 @@ static std::vector<FrameData> createFrameData(const vk::raii::Device& device, co
                 .usage = vma::MemoryUsage::eAuto,
             }, uniformBufferAllocationInfo);
 
-        vma::AllocationInfo instanceBufferAllocationInfo;
-        auto [instanceBuffer, instanceBufferAllocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
-                .size = 16777216,
-                .usage = vk::BufferUsageFlagBits::eStorageBuffer,
-            }, vma::AllocationCreateInfo {
-                .flags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-                .usage = vma::MemoryUsage::eAuto,
-            }, instanceBufferAllocationInfo);
+        auto [instanceBuffer, instanceBufferAllocation, instanceBufferAllocationInfo] = createInstanceBuffer(allocator, instanceCapacity);
 
-        const std::array bufferInfos {
-            vk::DescriptorBufferInfo {
-                .buffer = *uniformBuffer,
-                .range = vk::WholeSize,
-            },
-            vk::DescriptorBufferInfo {
-                .buffer = *instanceBuffer,
-                .range = vk::WholeSize,
-            },
+        vma::UniqueBuffer culledInstanceBuffer, indirectBuffer;
+        vma::UniqueAllocation culledInstanceBufferAllocation, indirectBufferAllocation;
+        if (gpuCulling)
+        {
+            std::tie(culledInstanceBuffer, culledInstanceBufferAllocation, indirectBuffer, indirectBufferAllocation) = createCullBuffers(allocator, instanceCapacity);
+        }
+
+        const vk::DescriptorBufferInfo uniformBufferInfo {
+            .buffer = *uniformBuffer,
+            .range = vk::WholeSize,
         };
 
-        device.updateDescriptorSets({
-                vk::WriteDescriptorSet {
-                    .dstSet = descriptorSets[0],
-                    .dstBinding = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eUniformBuffer,
-                    .pBufferInfo = &bufferInfos[0],
-                },
-                vk::WriteDescriptorSet {
-                    .dstSet = descriptorSets[1],
-                    .dstBinding = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo = &bufferInfos[1],
-                },
+        device.updateDescriptorSets(vk::WriteDescriptorSet {
+                .dstSet = descriptorSets[0],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eUniformBuffer,
+                .pBufferInfo = &uniformBufferInfo,
             }, {});
 
         frameData.push_back(FrameData {
-                .inFlightFence = vk::raii::Fence(device, vk::FenceCreateInfo {
-                        .flags = vk::FenceCreateFlagBits::eSignaled,
-                    }),
                 .imageAcquiredSemaphore = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo {}),
                 .renderFinishedSemaphore = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo {}),
                 .commandPool = std::move(commandPool),
                 .commandBuffers = std::move(commandBuffers),
+                .batchCommandPools = std::move(batchCommandPools),
+                .batchCommandBuffers = std::move(batchCommandBuffers),
                 .descriptorSets = std::move(descriptorSets),
                 .uniformBuffer = std::move(uniformBuffer),
                 .uniformBufferAllocation = std::move(uniformBufferAllocation),
@@ -291,7 +610,17 @@ static std::vector<FrameData> createFrameData(const vk::raii::Device& device, co
                 .instanceBuffer = std::move(instanceBuffer),
                 .instanceBufferAllocation = std::move(instanceBufferAllocation),
                 .instanceBufferAllocationInfo = std::move(instanceBufferAllocationInfo),
+                .instanceCapacity = instanceCapacity,
+                .culledInstanceBuffer = std::move(culledInstanceBuffer),
+                .culledInstanceBufferAllocation = std::move(culledInstanceBufferAllocation),
+                .indirectBuffer = std::move(indirectBuffer),
+                .indirectBufferAllocation = std::move(indirectBufferAllocation),
+                .timestampQueryPool = timestamps ? vk::raii::QueryPool(device, vk::QueryPoolCreateInfo {
+                        .queryType = vk::QueryType::eTimestamp,
+                        .queryCount = 2,
+                    }) : vk::raii::QueryPool(nullptr),
             });
+        writeInstanceDescriptorSets(device, frameData.back());
     }
 
     return frameData;
@@ -326,61 +655,410 @@ static void writeData(char*& writePointer, T&& value)
     WriteDataHelper<T>::writeData(writePointer, std::forward<T>(value));
 }
 
-Renderer::Renderer(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const uint32_t numFramesInFlight, const vk::Format colorAttachmentFormat) :
+Renderer::Renderer(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const uint32_t numFramesInFlight, const vk::Format colorAttachmentFormat, const uint32_t initialInstanceCapacity, const bool gpuCulling, const bool bindlessSupported, const uint32_t maxTextureArrays, const float timestampPeriod, ThreadPool* recordingThreadPool, const std::array<InstanceLayerInfo, SceneInterface::numInstanceLayers>& instanceLayers, const vk::raii::PipelineCache& pipelineCache, GpuTimeline& timeline) :
     device(device),
     queue(queue),
-    descriptorSetLayouts(createDescriptorSetLayouts(device, textures.size())),
-    pipelineLayout(createPipelineLayout(device, descriptorSetLayouts)),
-    pipeline(createPipeline(device, "shaders/test.vs.spv", "shaders/test.fs.spv", colorAttachmentFormat, pipelineLayout)),
-    textureSampler(device, vk::SamplerCreateInfo {}),
-    descriptorPool(createDescriptorPool(device, textures.size(), numFramesInFlight)),
-    textureDescriptorSet(createTextureDescriptorSet(device, descriptorPool, descriptorSetLayouts[0], textureSampler, textures)),
-    frameData(createFrameData(device, queueFamilyIndex, allocator, descriptorPool, { *descriptorSetLayouts[1], *descriptorSetLayouts[2] }, numFramesInFlight))
+    timeline(timeline),
+    allocator(allocator),
+    gpuCulling(gpuCulling),
+    bindlessSupported(bindlessSupported),
+    numTextureDescriptors(getNumTextureDescriptors(maxTextureArrays, bindlessSupported)),
+    timestampPeriod(timestampPeriod),
+    colorAttachmentFormat(colorAttachmentFormat),
+    recordingThreadPool(recordingThreadPool),
+    instanceLayers(instanceLayers),
+    samplers(createSamplers(device)),
+    descriptorSetLayouts(createDescriptorSetLayouts(device, numTextureDescriptors, bindlessSupported, samplers)),
+    pipelineLayout(createPipelineLayout(device, { *descriptorSetLayouts[0], *descriptorSetLayouts[1], *descriptorSetLayouts[2] }, vk::PushConstantRange {
+                .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                .offset = 0,
+                .size = sizeof(PushConstants),
+            })),
+    pipelines(createInstancePipelines(device, pipelineCache, "shaders/test.vs.spv", bindlessSupported ? "shaders/test.fs.spv" : "shaders/test_nobindless.fs.spv", colorAttachmentFormat, pipelineLayout)),
+    tilePipelineLayout(createPipelineLayout(device, { *descriptorSetLayouts[0], *descriptorSetLayouts[1], *descriptorSetLayouts[4] }, vk::PushConstantRange {
+                .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                .offset = 0,
+                .size = sizeof(TilePushConstants),
+            })),
+    tilePipeline(createPipeline(device, pipelineCache, "shaders/tile.vs.spv", bindlessSupported ? "shaders/tile.fs.spv" : "shaders/tile_nobindless.fs.spv", colorAttachmentFormat, false, tilePipelineLayout)),
+    cullPipelineLayout(createPipelineLayout(device, { *descriptorSetLayouts[3] }, vk::PushConstantRange {
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                .offset = 0,
+                .size = sizeof(CullPushConstants),
+            })),
+    cullPipeline(gpuCulling ? createCullPipeline(device, pipelineCache, "shaders/cull.cs.spv", cullPipelineLayout) : vk::raii::Pipeline(nullptr)),
+    descriptorPool(createDescriptorPool(device, numTextureDescriptors, bindlessSupported, numFramesInFlight)),
+    textureDescriptorSet(createTextureDescriptorSet(device, descriptorPool, descriptorSetLayouts[0], textures, numTextureDescriptors, bindlessSupported)),
+    frameData(createFrameData(device, queueFamilyIndex, allocator, descriptorPool, { *descriptorSetLayouts[1], *descriptorSetLayouts[2], *descriptorSetLayouts[2], *descriptorSetLayouts[3], *descriptorSetLayouts[4] }, numFramesInFlight, std::max(initialInstanceCapacity, 1u), gpuCulling, timestampPeriod > 0, recordingThreadPool ? numDrawBatches : 0))
 {
 }
 
+void Renderer::updateTextures(const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const std::vector<uint32_t>& slots)
+{
+    if (slots.empty())
+    {
+        return;
+    }
+    if (!bindlessSupported)
+    {
+        // without update after bind the set must not be in use by any submitted frame, and the fallback descriptors of the
+        // empty slots may have changed too
+        timeline.wait(timeline.lastSignaled());
+        std::vector<uint32_t> allSlots(numTextureDescriptors);
+        std::iota(allSlots.begin(), allSlots.end(), 0);
+        writeTextureDescriptors(device, textureDescriptorSet, textures, allSlots, numTextureDescriptors, bindlessSupported);
+        return;
+    }
+    writeTextureDescriptors(device, textureDescriptorSet, textures, slots, numTextureDescriptors, bindlessSupported);
+}
+
 void Renderer::beginFrame()
 {
-    if (auto result = device.waitForFences(*frameData[frameIndex].inFlightFence, vk::True, std::numeric_limits<uint64_t>::max()); result != vk::Result::eSuccess)
+    auto& frame = frameData[frameIndex];
+    frameStats = {};
+
+    // only the last frame that used this slot has to be done, the ones after it keep running
+    const auto waitBegin = std::chrono::steady_clock::now();
+    timeline.wait(frame.submittedValue);
+    frameStats.waitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitBegin).count();
+    timeline.collect();
+
+    if (frame.timestampsWritten)
     {
-        throw std::runtime_error("Unexpected return from waitForFences");
+        // the submission is done, so the results are available without waiting
+        const auto [result, timestamps] = frame.timestampQueryPool.getResults<uint64_t>(0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess)
+        {
+            frameStats.gpuTime = (timestamps[1] - timestamps[0]) * static_cast<double>(timestampPeriod) * 1e-9;
+            frameStats.gpuSubmitTime = frame.submitTime;
+        }
+        frame.timestampsWritten = false;
     }
-    device.resetFences({ frameData[frameIndex].inFlightFence });
 
-    frameData[frameIndex].commandPool.reset();
+    frame.commandPool.reset();
+    for (const auto& batchCommandPool : frame.batchCommandPools)
+    {
+        batchCommandPool.reset();
+    }
 }
 
-void Renderer::updateFrame(const std::vector<Instance>& instances, const glm::mat4& projection)
+void Renderer::updateFrame(InstanceStore& retainedInstances, const SceneInterface::InstanceLayers& instanceLayers, const TileMap& tileMap, const uint32_t tileMapVersion, const glm::mat4& projection, const glm::vec2& retainedInstanceOffset)
 {
-    auto writePointer = static_cast<char*>(frameData[frameIndex].uniformBufferAllocationInfo.pMappedData);
+    auto& frame = frameData[frameIndex];
+
+    auto writePointer = static_cast<char*>(frame.uniformBufferAllocationInfo.pMappedData);
     writeData(writePointer, projection);
 
-    writePointer = static_cast<char*>(frameData[frameIndex].instanceBufferAllocationInfo.pMappedData);
-    for (const auto& instance : instances)
+    frameStats.bytesUploaded += sizeof(projection);
+
+    if (frame.tileMapVersion != tileMapVersion)
+    {
+        updateTileMap(frame, tileMap);
+        frame.tileMapVersion = tileMapVersion;
+        frameStats.bytesUploaded += tileMap.width * tileMap.height * sizeof(uint32_t);
+    }
+
+    // every frame in flight has its own copy of the retained instances, so changes are replayed into each of them
+    if (auto [dirtyBegin, dirtyEnd] = retainedInstances.takeDirtyRange(); dirtyBegin < dirtyEnd)
+    {
+        for (auto& data : frameData)
+        {
+            data.retainedDirtyBegin = std::min(data.retainedDirtyBegin, dirtyBegin);
+            data.retainedDirtyEnd = std::max(data.retainedDirtyEnd, dirtyEnd);
+        }
+    }
+
+    uint32_t numImmediateInstances = 0;
+    for (const auto& instances : instanceLayers)
+    {
+        numImmediateInstances += instances.size();
+    }
+    const uint32_t numInstances = retainedInstances.size() + numImmediateInstances;
+    peakInstanceCount = std::max(peakInstanceCount, numInstances);
+    if (numInstances > frame.instanceCapacity)
+    {
+        growInstanceBuffer(frame, numInstances);
+
+        // the new buffer starts out empty
+        frame.retainedDirtyBegin = 0;
+        frame.retainedDirtyEnd = retainedInstances.size();
+    }
+
+    auto instanceData = static_cast<GpuInstance*>(frame.instanceBufferAllocationInfo.pMappedData);
+    if (frame.retainedDirtyBegin < frame.retainedDirtyEnd)
+    {
+        streamInstances(retainedInstances.instances.data() + frame.retainedDirtyBegin, frame.retainedDirtyEnd - frame.retainedDirtyBegin, instanceData + frame.retainedDirtyBegin);
+        frameStats.bytesUploaded += (frame.retainedDirtyEnd - frame.retainedDirtyBegin) * sizeof(GpuInstance);
+        frame.retainedDirtyBegin = std::numeric_limits<uint32_t>::max();
+        frame.retainedDirtyEnd = 0;
+    }
+
+    // layers are packed straight into the mapped buffer one after the other, which is their draw order
+    uint32_t offset = retainedInstances.size();
+    for (uint32_t layer = 0; layer < SceneInterface::numInstanceLayers; ++layer)
+    {
+        const auto& instances = instanceLayers[layer];
+        if (this->instanceLayers[layer].order == InstanceOrder::Texture && instances.size() > 1)
+        {
+            // the index in the low bits keeps the sort stable
+            sortKeys.resize(instances.size());
+            for (uint32_t i = 0; i < instances.size(); ++i)
+            {
+                sortKeys[i] = (static_cast<uint64_t>(instances[i].textureIndex) << 32) | i;
+            }
+            std::sort(sortKeys.begin(), sortKeys.end());
+            sortedInstances.resize(instances.size());
+            for (uint32_t i = 0; i < instances.size(); ++i)
+            {
+                sortedInstances[i] = instances[static_cast<uint32_t>(sortKeys[i])];
+            }
+            packInstances(sortedInstances.data(), sortedInstances.size(), instanceData + offset);
+        }
+        else
+        {
+            packInstances(instances.data(), instances.size(), instanceData + offset);
+        }
+        frame.numLayerInstances[layer] = instances.size();
+        offset += instances.size();
+    }
+
+    frame.numRetainedInstances = retainedInstances.size();
+    frame.numImmediateInstances = numImmediateInstances;
+    frame.retainedInstanceOffset = retainedInstanceOffset;
+    frameStats.numInstances = numInstances;
+    frameStats.bytesUploaded += numImmediateInstances * sizeof(GpuInstance);
+}
+
+void Renderer::growInstanceBuffer(FrameData& frame, const uint32_t numInstances)
+{
+    // only called for the current frame, after beginFrame has waited for its last submission, so the old buffer is no longer in use
+    uint32_t instanceCapacity = frame.instanceCapacity;
+    while (instanceCapacity < numInstances)
+    {
+        instanceCapacity *= 2;
+    }
+
+    std::tie(frame.instanceBuffer, frame.instanceBufferAllocation, frame.instanceBufferAllocationInfo) = createInstanceBuffer(allocator, instanceCapacity);
+    if (gpuCulling)
+    {
+        std::tie(frame.culledInstanceBuffer, frame.culledInstanceBufferAllocation, frame.indirectBuffer, frame.indirectBufferAllocation) = createCullBuffers(allocator, instanceCapacity);
+    }
+    frame.instanceCapacity = instanceCapacity;
+
+    writeInstanceDescriptorSets(device, frame);
+}
+
+void Renderer::updateTileMap(FrameData& frame, const TileMap& tileMap)
+{
+    const uint32_t numTiles = tileMap.width * tileMap.height;
+    if (tileMap.tiles.size() < numTiles)
+    {
+        throw std::runtime_error("Tile map has fewer tiles than width * height");
+    }
+
+    if (numTiles > frame.tileCapacity)
+    {
+        auto [tileBuffer, tileBufferAllocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
+                .size = numTiles * sizeof(uint32_t),
+                .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+            }, vma::AllocationCreateInfo {
+                .flags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+                .usage = vma::MemoryUsage::eAuto,
+            }, frame.tileBufferAllocationInfo);
+        frame.tileBuffer = std::move(tileBuffer);
+        frame.tileBufferAllocation = std::move(tileBufferAllocation);
+        frame.tileCapacity = numTiles;
+
+        const vk::DescriptorBufferInfo bufferInfo {
+            .buffer = *frame.tileBuffer,
+            .range = vk::WholeSize,
+        };
+        device.updateDescriptorSets(vk::WriteDescriptorSet {
+                .dstSet = frame.descriptorSets[4],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &bufferInfo,
+            }, {});
+    }
+
+    if (numTiles > 0)
+    {
+        std::memcpy(frame.tileBufferAllocationInfo.pMappedData, tileMap.tiles.data(), numTiles * sizeof(uint32_t));
+    }
+    frame.tileMapWidth = tileMap.width;
+    frame.tileMapHeight = tileMap.height;
+    frame.tileMapPosition = tileMap.position;
+    frame.tileMapBackgroundTextureIndex = tileMap.backgroundTextureIndex;
+}
+
+InstanceBufferStats Renderer::instanceBufferStats() const
+{
+    InstanceBufferStats stats {
+        .instanceCapacity = std::numeric_limits<uint32_t>::max(),
+        .peakInstanceCount = peakInstanceCount,
+        .instanceBufferBytes = 0,
+        .allocatedBytes = allocator.calculateStatistics().total.statistics.allocationBytes,
+    };
+    for (const auto& frame : frameData)
+    {
+        stats.instanceCapacity = std::min(stats.instanceCapacity, frame.instanceCapacity);
+        stats.instanceBufferBytes += frame.instanceBufferAllocationInfo.size;
+    }
+    return stats;
+}
+
+bool Renderer::hasDrawBatch(const FrameData& frame, const uint32_t batch) const
+{
+    switch (batch)
     {
-        writeData(writePointer, instance.position);
-        writeData(writePointer, instance.scale);
-        writeData(writePointer, instance.minTexCoord);
-        writeData(writePointer, instance.texCoordScale);
-        writeData(writePointer, glm::vec2(glm::cos(instance.angle), glm::sin(instance.angle)));
-        writeData(writePointer, instance.textureIndex);
-        writeData(writePointer, 0.0f); // padding
-        writeData(writePointer, instance.tintColor);
+        case tileMapBatch:
+            return frame.tileMapWidth > 0 && frame.tileMapHeight > 0;
+        case retainedBatch:
+            return frame.numRetainedInstances > 0;
+        default:
+            return frame.numLayerInstances[batch - firstLayerBatch] > 0;
     }
 }
 
-void Renderer::drawFrame(const Swapchain& swapchain, const glm::vec2& viewportOffset, const glm::vec2& viewportExtent, const uint32_t numInstances)
+void Renderer::recordDrawBatch(const vk::raii::CommandBuffer& commandBuffer, const FrameData& frame, const uint32_t batch, const vk::Viewport& viewport, const vk::Rect2D& scissor) const
 {
-    auto [acquireResult, imageIndex] = swapchain.swapchain.acquireNextImage(std::numeric_limits<uint64_t>::max(), frameData[frameIndex].imageAcquiredSemaphore, nullptr);
+    commandBuffer.setViewport(0, viewport);
+    commandBuffer.setScissor(0, scissor);
+
+    if (batch == tileMapBatch)
+    {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, tilePipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, tilePipelineLayout, 0, {
+                textureDescriptorSet,
+                frame.descriptorSets[0],
+                frame.descriptorSets[4],
+            }, {});
+        commandBuffer.pushConstants<TilePushConstants>(tilePipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, TilePushConstants {
+                .positionOffset = frame.retainedInstanceOffset,
+                .position = frame.tileMapPosition,
+                .width = frame.tileMapWidth,
+                .height = frame.tileMapHeight,
+                .backgroundTextureIndex = frame.tileMapBackgroundTextureIndex,
+            });
+        commandBuffer.draw(4, 1, 0, 0);
+        return;
+    }
+
+    // the instances of the layers follow the retained ones, and so do their cull commands
+    const uint32_t numRetainedGroups = numCullGroups(frame.numRetainedInstances);
+    uint32_t firstInstance = 0;
+    uint32_t firstCommand = 0;
+    uint32_t numInstances = frame.numRetainedInstances;
+    BlendMode blendMode = BlendMode::Alpha;
+    if (batch != retainedBatch)
+    {
+        const uint32_t layer = batch - firstLayerBatch;
+        firstInstance = frame.numRetainedInstances;
+        firstCommand = numRetainedGroups;
+        for (uint32_t previousLayer = 0; previousLayer < layer; ++previousLayer)
+        {
+            firstInstance += frame.numLayerInstances[previousLayer];
+            firstCommand += numCullGroups(frame.numLayerInstances[previousLayer]);
+        }
+        numInstances = frame.numLayerInstances[layer];
+        blendMode = instanceLayers[layer].blendMode;
+    }
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[static_cast<uint32_t>(blendMode)]);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, {
+            textureDescriptorSet,
+            frame.descriptorSets[0],
+            gpuCulling ? frame.descriptorSets[2] : frame.descriptorSets[1],
+        }, {});
+    commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, PushConstants {
+            .positionOffset = batch == retainedBatch ? frame.retainedInstanceOffset : glm::vec2(0, 0),
+        });
+    if (gpuCulling)
+    {
+        commandBuffer.drawIndirect(*frame.indirectBuffer, firstCommand * sizeof(vk::DrawIndirectCommand), numCullGroups(numInstances), sizeof(vk::DrawIndirectCommand));
+    }
+    else
+    {
+        commandBuffer.draw(4, numInstances, 0, firstInstance);
+    }
+}
+
+void Renderer::drawFrame(Swapchain& swapchain, const glm::vec2& viewportOffset, const glm::vec2& viewportExtent)
+{
+    auto& frame = frameData[frameIndex];
+
+    // called through the dispatcher, the raii wrappers throw on eErrorOutOfDateKHR which is routine on resizes and moves
+    uint32_t imageIndex;
+    const auto acquireBegin = std::chrono::steady_clock::now();
+    const auto acquireResult = static_cast<vk::Result>(device.getDispatcher()->vkAcquireNextImageKHR(*device, *swapchain.swapchain, std::numeric_limits<uint64_t>::max(), *frameData[frameIndex].imageAcquiredSemaphore, nullptr, &imageIndex));
+    frameStats.waitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - acquireBegin).count();
+    if (acquireResult == vk::Result::eErrorOutOfDateKHR)
+    {
+        // nothing was acquired or submitted, the frame is just skipped
+        swapchain.outOfDate = true;
+        return;
+    }
     if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR)
     {
         throw std::runtime_error("Unexpected return from acquireNextImage");
     }
+    // the image is acquired and its semaphore signaled, so this frame still goes through
+    swapchain.outOfDate = swapchain.outOfDate || acquireResult == vk::Result::eSuboptimalKHR;
 
     const auto& commandBuffer = frameData[frameIndex].commandBuffers.front();
     commandBuffer.begin(vk::CommandBufferBeginInfo {
         .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
     });
+    if (*frame.timestampQueryPool)
+    {
+        commandBuffer.resetQueryPool(frame.timestampQueryPool, 0, 2);
+    }
+
+    const uint32_t numRetainedGroups = numCullGroups(frame.numRetainedInstances);
+    if (gpuCulling)
+    {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullPipelineLayout, 0, { frame.descriptorSets[3] }, {});
+
+        commandBuffer.pushConstants<CullPushConstants>(cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, CullPushConstants {
+                .positionOffset = frame.retainedInstanceOffset,
+                .firstInstance = 0,
+                .numInstances = frame.numRetainedInstances,
+                .firstCommand = 0,
+            });
+        commandBuffer.dispatch(numRetainedGroups, 1, 1);
+
+        // each layer gets its own commands, so its draws can use its own pipeline
+        uint32_t firstInstance = frame.numRetainedInstances;
+        uint32_t firstCommand = numRetainedGroups;
+        for (const uint32_t numInstances : frame.numLayerInstances)
+        {
+            if (numInstances > 0)
+            {
+                commandBuffer.pushConstants<CullPushConstants>(cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, CullPushConstants {
+                        .positionOffset = { 0, 0 },
+                        .firstInstance = firstInstance,
+                        .numInstances = numInstances,
+                        .firstCommand = firstCommand,
+                    });
+                commandBuffer.dispatch(numCullGroups(numInstances), 1, 1);
+            }
+            firstInstance += numInstances;
+            firstCommand += numCullGroups(numInstances);
+        }
+
+        const vk::MemoryBarrier2 cullMemoryBarrier {
+            .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader,
+            .dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead,
+        };
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo {
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &cullMemoryBarrier,
+        });
+    }
 
     const vk::ImageMemoryBarrier2 initialImageMemoryBarrier {
         .srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe,
@@ -404,34 +1082,122 @@ void Renderer::drawFrame(const Swapchain& swapchain, const glm::vec2& viewportOf
         .storeOp = vk::AttachmentStoreOp::eStore,
         .clearValue = vk::ClearValue({ 0.0f, 0.0f, 0.0f, 0.0f }),
     };
+    if (*frame.timestampQueryPool)
+    {
+        commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, frame.timestampQueryPool, 0);
+    }
+    const vk::Viewport viewport {
+        .x = viewportOffset.x,
+        .y = viewportOffset.y,
+        .width = viewportExtent.x,
+        .height = viewportExtent.y,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    const vk::Rect2D scissor {
+        .extent = swapchain.extent,
+    };
+    std::array<uint32_t, numDrawBatches> batches;
+    uint32_t numBatches = 0;
+    for (uint32_t batch = 0; batch < numDrawBatches; ++batch)
+    {
+        if (hasDrawBatch(frame, batch))
+        {
+            batches[numBatches++] = batch;
+        }
+    }
+
+    std::vector<vk::CommandBuffer> batchCommandBuffers;
+    if (recordingThreadPool)
+    {
+        // the calling thread takes the first batch
+        const auto record = [&](const uint32_t batch)
+            {
+                ProfileScope scope("recordDrawBatch");
+                const vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo {
+                    .colorAttachmentCount = 1,
+                    .pColorAttachmentFormats = &colorAttachmentFormat,
+                    .rasterizationSamples = vk::SampleCountFlagBits::e1,
+                };
+                const vk::CommandBufferInheritanceInfo inheritanceInfo {
+                    .pNext = &inheritanceRenderingInfo,
+                };
+                const auto& batchCommandBuffer = frame.batchCommandBuffers[batch];
+                batchCommandBuffer.begin(vk::CommandBufferBeginInfo {
+                    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                    .pInheritanceInfo = &inheritanceInfo,
+                });
+                recordDrawBatch(batchCommandBuffer, frame, batch, viewport, scissor);
+                batchCommandBuffer.end();
+            };
+        std::vector<std::future<void>> futures;
+        for (uint32_t i = 1; i < numBatches; ++i)
+        {
+            futures.push_back(recordingThreadPool->submit([&record, batch = batches[i]] { record(batch); }));
+        }
+        std::exception_ptr exception;
+        try
+        {
+            if (numBatches > 0)
+            {
+                record(batches[0]);
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        // the jobs reference this frame's locals, so every one of them has to finish before anything is rethrown
+        for (auto& future : futures)
+        {
+            try
+            {
+                future.get();
+            }
+            catch (...)
+            {
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+            }
+        }
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        for (uint32_t i = 0; i < numBatches; ++i)
+        {
+            batchCommandBuffers.push_back(*frame.batchCommandBuffers[batches[i]]);
+        }
+    }
+
     commandBuffer.beginRendering(vk::RenderingInfo {
+        .flags = recordingThreadPool ? vk::RenderingFlags(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers) : vk::RenderingFlags {},
         .renderArea = vk::Rect2D { .extent = swapchain.extent },
         .layerCount = 1,
         .colorAttachmentCount = 1,
         .pColorAttachments = &renderingAttachmentInfo,
     });
-
-    commandBuffer.setViewport(0, vk::Viewport {
-            .x = viewportOffset.x,
-            .y = viewportOffset.y,
-            .width = viewportExtent.x,
-            .height = viewportExtent.y,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        });
-    commandBuffer.setScissor(0, vk::Rect2D {
-            .extent = swapchain.extent,
-        });
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, {
-            textureDescriptorSet,
-            frameData[frameIndex].descriptorSets[0],
-            frameData[frameIndex].descriptorSets[1],
-        }, {});
-
-    commandBuffer.draw(4, numInstances, 0, 0);
-
+    if (recordingThreadPool)
+    {
+        if (!batchCommandBuffers.empty())
+        {
+            commandBuffer.executeCommands(batchCommandBuffers);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < numBatches; ++i)
+        {
+            recordDrawBatch(commandBuffer, frame, batches[i], viewport, scissor);
+        }
+    }
     commandBuffer.endRendering();
+    if (*frame.timestampQueryPool)
+    {
+        commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, frame.timestampQueryPool, 1);
+    }
 
     const vk::ImageMemoryBarrier2 finalImageMemoryBarrier {
         .srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
@@ -459,35 +1225,51 @@ void Renderer::drawFrame(const Swapchain& swapchain, const glm::vec2& viewportOf
         .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
     };
 
-    const vk::SemaphoreSubmitInfo signalSemaphoreInfo {
-        .semaphore = frameData[frameIndex].renderFinishedSemaphore,
-        .stageMask = vk::PipelineStageFlagBits2::eBottomOfPipe,
+    // the presentation engine only takes binary semaphores, the timeline value tracks the frame for the CPU
+    const std::array<vk::SemaphoreSubmitInfo, 2> signalSemaphoreInfos {
+        vk::SemaphoreSubmitInfo {
+            .semaphore = frameData[frameIndex].renderFinishedSemaphore,
+            .stageMask = vk::PipelineStageFlagBits2::eBottomOfPipe,
+        },
+        timeline.signal(vk::PipelineStageFlagBits2::eAllCommands),
     };
+    frameData[frameIndex].submittedValue = signalSemaphoreInfos[1].value;
+    frame.timestampsWritten = static_cast<bool>(*frame.timestampQueryPool);
+    frame.submitTime = std::chrono::steady_clock::now();
 
     queue.submit2(vk::SubmitInfo2 {
             .waitSemaphoreInfoCount = 1,
             .pWaitSemaphoreInfos = &waitSemaphoreInfo,
             .commandBufferInfoCount = 1,
             .pCommandBufferInfos = &commandBufferSubmitInfo,
-            .signalSemaphoreInfoCount = 1,
-            .pSignalSemaphoreInfos = &signalSemaphoreInfo,
-        }, frameData[frameIndex].inFlightFence);
-
-    if (auto result = queue.presentKHR(vk::PresentInfoKHR {
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*frameData[frameIndex].renderFinishedSemaphore,
-                .swapchainCount = 1,
-                .pSwapchains = &*swapchain.swapchain,
-                .pImageIndices = &imageIndex,
-            });
-            result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+            .signalSemaphoreInfoCount = static_cast<uint32_t>(signalSemaphoreInfos.size()),
+            .pSignalSemaphoreInfos = signalSemaphoreInfos.data(),
+        });
+
+    const uint64_t presentId = swapchain.lastPresentId + 1;
+    const vk::PresentIdKHR presentIdInfo {
+        .swapchainCount = 1,
+        .pPresentIds = &presentId,
+    };
+    if (swapchain.presentWaitEnabled)
     {
-        throw std::runtime_error("Unexpected return from presentKHR");
+        swapchain.lastPresentId = presentId;
     }
-    else if (result == vk::Result::eSuboptimalKHR)
+
+    const vk::PresentInfoKHR presentInfo {
+        .pNext = swapchain.presentWaitEnabled ? &presentIdInfo : nullptr,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*frameData[frameIndex].renderFinishedSemaphore,
+        .swapchainCount = 1,
+        .pSwapchains = &*swapchain.swapchain,
+        .pImageIndices = &imageIndex,
+    };
+    const auto presentResult = static_cast<vk::Result>(queue.getDispatcher()->vkQueuePresentKHR(*queue, reinterpret_cast<const VkPresentInfoKHR*>(&presentInfo)));
+    if (presentResult != vk::Result::eSuccess && presentResult != vk::Result::eSuboptimalKHR && presentResult != vk::Result::eErrorOutOfDateKHR)
     {
-        // TODO: recreate swapchain
+        throw std::runtime_error("Unexpected return from presentKHR");
     }
+    swapchain.outOfDate = swapchain.outOfDate || presentResult != vk::Result::eSuccess;
 }
 
 void Renderer::nextFrame()
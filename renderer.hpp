@@ -1,20 +1,31 @@
 #pragma once
 
+#include "engine.hpp"
+#include "profiler.hpp"
 #include "vulkan_includes.hpp"
 #include <glm/glm.hpp>
+#include <chrono>
+#include <limits>
 
 namespace eng
 {
-    struct Instance;
+    struct GpuTimeline;
+    struct InstanceStore;
     struct Swapchain;
+    struct ThreadPool;
 
     struct FrameData
     {
-        vk::raii::Fence inFlightFence;
         vk::raii::Semaphore imageAcquiredSemaphore;
         vk::raii::Semaphore renderFinishedSemaphore;
+        // GpuTimeline value signaled by the last submission using this frame's resources
+        uint64_t submittedValue = 0;
         vk::raii::CommandPool commandPool;
         vk::raii::CommandBuffers commandBuffers;
+        // one pool and secondary command buffer per draw batch, so the batches can be recorded on different threads,
+        // empty when they are recorded straight into the primary one
+        std::vector<vk::raii::CommandPool> batchCommandPools;
+        std::vector<vk::raii::CommandBuffer> batchCommandBuffers;
         vk::raii::DescriptorSets descriptorSets;
         vma::UniqueBuffer uniformBuffer;
         vma::UniqueAllocation uniformBufferAllocation;
@@ -22,26 +33,102 @@ namespace eng
         vma::UniqueBuffer instanceBuffer;
         vma::UniqueAllocation instanceBufferAllocation;
         vma::AllocationInfo instanceBufferAllocationInfo;
+        uint32_t instanceCapacity;
+        vma::UniqueBuffer culledInstanceBuffer;
+        vma::UniqueAllocation culledInstanceBufferAllocation;
+        vma::UniqueBuffer indirectBuffer;
+        vma::UniqueAllocation indirectBufferAllocation;
+        vma::UniqueBuffer tileBuffer;
+        vma::UniqueAllocation tileBufferAllocation;
+        vma::AllocationInfo tileBufferAllocationInfo;
+        uint32_t tileCapacity = 0;
+        uint32_t tileMapVersion = 0;
+        uint32_t tileMapWidth = 0;
+        uint32_t tileMapHeight = 0;
+        glm::vec2 tileMapPosition = { 0, 0 };
+        uint32_t tileMapBackgroundTextureIndex = 0;
+        uint32_t retainedDirtyBegin = std::numeric_limits<uint32_t>::max();
+        uint32_t retainedDirtyEnd = 0;
+        uint32_t numRetainedInstances = 0;
+        uint32_t numImmediateInstances = 0;
+        std::array<uint32_t, SceneInterface::numInstanceLayers> numLayerInstances = {};
+        glm::vec2 retainedInstanceOffset = { 0, 0 };
+        // two timestamps around rendering, null when the renderer doesn't measure GPU time
+        vk::raii::QueryPool timestampQueryPool = nullptr;
+        bool timestampsWritten = false;
+        std::chrono::steady_clock::time_point submitTime;
+    };
+
+    struct InstanceBufferStats
+    {
+        uint32_t instanceCapacity;
+        uint32_t peakInstanceCount;
+        vk::DeviceSize instanceBufferBytes;
+        vk::DeviceSize allocatedBytes;
     };
 
     struct Renderer
     {
-        explicit Renderer(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const uint32_t numFramesInFlight, const vk::Format colorAttachmentFormat);
+        // must match MAX_TEXTURE_ARRAYS in shaders/textures.glsl
+        static constexpr uint32_t maxNonBindlessTextureArrays = 8;
+        // one per eng::Sampler, must match NUM_SAMPLERS in shaders/textures.glsl
+        static constexpr uint32_t numSamplers = 2;
+        // what is drawn inside rendering: the tile map, the retained instances, then each instance layer
+        static constexpr uint32_t tileMapBatch = 0;
+        static constexpr uint32_t retainedBatch = 1;
+        static constexpr uint32_t firstLayerBatch = 2;
+        static constexpr uint32_t numDrawBatches = firstLayerBatch + SceneInterface::numInstanceLayers;
 
+        explicit Renderer(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator, const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const uint32_t numFramesInFlight, const vk::Format colorAttachmentFormat, const uint32_t initialInstanceCapacity, const bool gpuCulling, const bool bindlessSupported, const uint32_t maxTextureArrays, const float timestampPeriod, ThreadPool* recordingThreadPool, const std::array<InstanceLayerInfo, SceneInterface::numInstanceLayers>& instanceLayers, const vk::raii::PipelineCache& pipelineCache, GpuTimeline& timeline);
+
+        // Rewrites the texture descriptors of the slots, see TextureLoader::update. Called between frames.
+        void updateTextures(const std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>>& textures, const std::vector<uint32_t>& slots);
         void beginFrame();
-        void updateFrame(const std::vector<Instance>& instances, const glm::mat4& projection);
-        void drawFrame(const Swapchain& swapchain, const glm::vec2& viewportOffset, const glm::vec2& viewportExtent, const uint32_t numInstances);
+        void updateFrame(InstanceStore& retainedInstances, const SceneInterface::InstanceLayers& instanceLayers, const TileMap& tileMap, const uint32_t tileMapVersion, const glm::mat4& projection, const glm::vec2& retainedInstanceOffset);
+        void drawFrame(Swapchain& swapchain, const glm::vec2& viewportOffset, const glm::vec2& viewportExtent);
         void nextFrame();
 
+        InstanceBufferStats instanceBufferStats() const;
+
         const vk::raii::Device& device;
         const vk::raii::Queue& queue;
+        GpuTimeline& timeline;
+        const vma::Allocator& allocator;
+        const bool gpuCulling;
+        const bool bindlessSupported;
+        const uint32_t numTextureDescriptors;
+        // nanoseconds per timestamp tick, 0 to not measure GPU time
+        const float timestampPeriod;
+        const vk::Format colorAttachmentFormat;
+        // records the draw batches into secondary command buffers in parallel, they go straight into the primary
+        // command buffer without one
+        ThreadPool* const recordingThreadPool;
+        const std::array<InstanceLayerInfo, SceneInterface::numInstanceLayers> instanceLayers;
+        const std::vector<vk::raii::Sampler> samplers;
         const std::vector<vk::raii::DescriptorSetLayout> descriptorSetLayouts;
         const vk::raii::PipelineLayout pipelineLayout;
-        const vk::raii::Pipeline pipeline;
-        const vk::raii::Sampler textureSampler;
+        // by BlendMode, retained instances use Alpha
+        const std::vector<vk::raii::Pipeline> pipelines;
+        const vk::raii::PipelineLayout tilePipelineLayout;
+        const vk::raii::Pipeline tilePipeline;
+        const vk::raii::PipelineLayout cullPipelineLayout;
+        const vk::raii::Pipeline cullPipeline;
         const vk::raii::DescriptorPool descriptorPool;
         const vk::raii::DescriptorSet textureDescriptorSet;
-        const std::vector<FrameData> frameData;
+        std::vector<FrameData> frameData;
         uint32_t frameIndex = 0;
+        uint32_t peakInstanceCount = 0;
+        // of the frame being built, reset by beginFrame, the GPU time is the one of the frame whose resources it reuses
+        FrameStats frameStats;
+        // scratch for layers drawn in InstanceOrder::Texture
+        std::vector<uint64_t> sortKeys;
+        std::vector<Instance> sortedInstances;
+
+    private:
+        void growInstanceBuffer(FrameData& frame, const uint32_t numInstances);
+        void updateTileMap(FrameData& frame, const TileMap& tileMap);
+        bool hasDrawBatch(const FrameData& frame, const uint32_t batch) const;
+        // binds everything it uses, secondary command buffers don't inherit any state
+        void recordDrawBatch(const vk::raii::CommandBuffer& commandBuffer, const FrameData& frame, const uint32_t batch, const vk::Viewport& viewport, const vk::Rect2D& scissor) const;
     };
 }
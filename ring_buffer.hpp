@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A FIFO queue on one power of two sized array. Unlike std::deque it never frees, clear() and popping keep the
+// capacity, so a queue that is emptied and refilled every level stops allocating once it reached its largest size.
+template<typename T>
+struct RingBuffer
+{
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    T& operator[](const size_t index)
+    {
+        return slots[(head + index) & (slots.size() - 1)];
+    }
+
+    const T& operator[](const size_t index) const
+    {
+        return slots[(head + index) & (slots.size() - 1)];
+    }
+
+    T& front()
+    {
+        return slots[head];
+    }
+
+    const T& front() const
+    {
+        return slots[head];
+    }
+
+    void push_back(T value)
+    {
+        if (count == slots.size())
+        {
+            grow();
+        }
+        (*this)[count++] = std::move(value);
+    }
+
+    void pop_front()
+    {
+        head = (head + 1) & (slots.size() - 1);
+        --count;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        std::vector<T> values;
+        values.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            values.push_back((*this)[i]);
+        }
+        archive(values);
+        clear();
+        for (T& value : values)
+        {
+            push_back(std::move(value));
+        }
+    }
+
+private:
+    // unwraps the elements to the front of the new array
+    void grow()
+    {
+        std::vector<T> grown(slots.empty() ? 16 : 2 * slots.size());
+        for (size_t i = 0; i < count; ++i)
+        {
+            grown[i] = std::move((*this)[i]);
+        }
+        slots = std::move(grown);
+        head = 0;
+    }
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "engine.hpp"
+#include "instance_store.hpp"
+#include "thread_pool.hpp"
+
+#include <exception>
+#include <future>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+namespace eng
+{
+    struct Scene final : public SceneInterface
+    {
+        std::vector<Instance>& instances(const uint32_t layer) override
+        {
+            return instances_.at(layer);
+        }
+
+        std::vector<uint32_t>& instanceKeys(const uint32_t layer) override
+        {
+            return instanceKeys_.at(layer);
+        }
+
+        uint32_t createInstance(const Instance& instance) override
+        {
+            return retainedInstances_.create(instance);
+        }
+
+        void updateInstance(const uint32_t handle, const Instance& instance) override
+        {
+            retainedInstances_.update(handle, instance);
+        }
+
+        void destroyInstance(const uint32_t handle) override
+        {
+            retainedInstances_.destroy(handle);
+        }
+
+        void setTileMap(TileMap&& tileMap) override
+        {
+            tileMap_ = std::move(tileMap);
+            ++tileMapVersion_;
+        }
+
+        glm::vec2& retainedInstanceOffset() override
+        {
+            return retainedInstanceOffset_;
+        }
+
+        glm::mat4& projection() override
+        {
+            return projection_;
+        }
+
+        glm::vec2& viewportOffset() override
+        {
+            return viewportOffset_;
+        }
+
+        glm::vec2& viewportExtent() override
+        {
+            return viewportExtent_;
+        }
+
+        std::pair<uint32_t, uint32_t> framebufferSize() const override
+        {
+            return framebufferSize_;
+        }
+
+        void runInParallel(std::initializer_list<std::function<void()>> jobs) override
+        {
+            if (jobs.size() == 0)
+            {
+                return;
+            }
+            std::vector<std::future<void>> futures;
+            if (threadPool_)
+            {
+                futures.reserve(jobs.size() - 1);
+                for (auto job = jobs.begin() + 1; job != jobs.end(); ++job)
+                {
+                    futures.push_back(threadPool_->submit(std::function(*job)));
+                }
+            }
+            // the calling thread takes the first job, or all of them without a pool
+            std::exception_ptr exception;
+            for (auto job = jobs.begin(), end = threadPool_ ? jobs.begin() + 1 : jobs.end(); job != end && !exception; ++job)
+            {
+                try
+                {
+                    (*job)();
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+            }
+            // the jobs reference the caller's locals, so every one of them has to finish before anything is rethrown
+            for (auto& future : futures)
+            {
+                try
+                {
+                    future.get();
+                }
+                catch (...)
+                {
+                    exception = exception ? exception : std::current_exception();
+                }
+            }
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+
+        InstanceLayers instances_;
+        InstanceKeyLayers instanceKeys_;
+        InstanceStore retainedInstances_;
+        TileMap tileMap_;
+        uint32_t tileMapVersion_ = 0;
+        glm::vec2 retainedInstanceOffset_ = { 0, 0 };
+        glm::mat4 projection_;
+        glm::vec2 viewportOffset_;
+        glm::vec2 viewportExtent_;
+        std::pair<uint32_t, uint32_t> framebufferSize_;
+        // runInParallel runs everything on the calling thread without one
+        ThreadPool* threadPool_ = nullptr;
+    };
+}
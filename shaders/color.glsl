@@ -0,0 +1,7 @@
+// Set by eng::Renderer from the color attachment format. Without an sRGB attachment the shader encodes its output itself.
+layout(constant_id = 0) const bool srgbAttachment = true;
+
+vec4 encodeOutput(vec4 color)
+{
+    return srgbAttachment ? color : vec4(pow(color.rgb, vec3(1.0 / 2.2)), color.a);
+}
@@ -0,0 +1,105 @@
+#version 450 core
+
+layout(local_size_x = 64) in;
+
+layout(set = 0, binding = 0) uniform Matrices
+{
+    mat4 projection;
+};
+
+// must match eng::GpuInstance
+struct Instance
+{
+    vec2 position;
+    vec2 scale;
+    vec2 minTexCoord;
+    vec2 texCoordScale;
+    float cosAngle;
+    float sinAngle;
+    uint textureIndex;
+    uint samplerIndex;
+    vec4 tintColor;
+};
+
+struct DrawCommand
+{
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+};
+
+layout(std140, set = 0, binding = 1) readonly buffer InstanceData
+{
+    Instance instances[];
+};
+
+layout(std140, set = 0, binding = 2) writeonly buffer CulledInstanceData
+{
+    Instance culledInstances[];
+};
+
+layout(std430, set = 0, binding = 3) writeonly buffer DrawCommands
+{
+    DrawCommand drawCommands[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    vec2 positionOffset;
+    uint firstInstance;
+    uint numInstances;
+    uint firstCommand;
+};
+
+shared bool visible[gl_WorkGroupSize.x];
+
+bool isVisible(uint index)
+{
+    const vec2 scale = instances[index].scale;
+    if (scale.x == 0 || scale.y == 0)
+    {
+        return false;
+    }
+
+    // test the square bounding the quad at any rotation
+    const vec2 center = instances[index].position + positionOffset;
+    const float halfExtent = 0.5 * length(scale);
+    vec2 minCorner = vec2(3.402823e38);
+    vec2 maxCorner = vec2(-3.402823e38);
+    for (int i = 0; i < 4; ++i)
+    {
+        const vec2 corner = center + halfExtent * vec2((i & 1) == 0 ? -1 : 1, (i & 2) == 0 ? -1 : 1);
+        const vec4 clip = projection * vec4(corner, 0, 1);
+        minCorner = min(minCorner, clip.xy / clip.w);
+        maxCorner = max(maxCorner, clip.xy / clip.w);
+    }
+    return all(lessThanEqual(minCorner, vec2(1.0))) && all(greaterThanEqual(maxCorner, vec2(-1.0)));
+}
+
+void main()
+{
+    const uint localIndex = gl_LocalInvocationID.x;
+    const uint groupStart = gl_WorkGroupID.x * gl_WorkGroupSize.x;
+    const uint index = groupStart + localIndex;
+
+    visible[localIndex] = index < numInstances && isVisible(firstInstance + index);
+    barrier();
+
+    // compact within the group so every group's draw keeps the submission order
+    uint offset = 0;
+    for (uint i = 0; i < localIndex; ++i)
+    {
+        offset += visible[i] ? 1 : 0;
+    }
+
+    if (visible[localIndex])
+    {
+        culledInstances[firstInstance + groupStart + offset] = instances[firstInstance + index];
+    }
+
+    if (localIndex == gl_WorkGroupSize.x - 1)
+    {
+        drawCommands[firstCommand + gl_WorkGroupID.x] = DrawCommand(4, offset + (visible[localIndex] ? 1 : 0), 0, firstInstance + groupStart);
+    }
+}
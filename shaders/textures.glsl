@@ -0,0 +1,47 @@
+// Texture indices hold the array image in the upper and the layer in the lower 16 bits, see eng::TextureLoader.
+// Sampler indices are eng::Sampler values.
+
+// must match eng::Renderer::numSamplers
+#define NUM_SAMPLERS 2
+
+#ifdef NO_BINDLESS
+// must match eng::Renderer::maxNonBindlessTextureArrays
+#define MAX_TEXTURE_ARRAYS 8
+
+layout(set = 0, binding = 0) uniform texture2DArray textures[MAX_TEXTURE_ARRAYS];
+layout(set = 0, binding = 1) uniform sampler samplers[NUM_SAMPLERS];
+
+vec4 sampleTextureGrad(uint textureIndex, uint samplerIndex, vec2 texCoord, vec2 dx, vec2 dy)
+{
+    // without non-uniform indexing only constant indices are safe, so select the descriptors with a branch per slot
+    const uint arrayIndex = textureIndex >> 16;
+    const vec3 coord = vec3(texCoord, float(textureIndex & 0xFFFFu));
+    vec4 color = vec4(0);
+    for (uint i = 0; i < MAX_TEXTURE_ARRAYS; ++i)
+    {
+        for (uint j = 0; j < NUM_SAMPLERS; ++j)
+        {
+            if (i == arrayIndex && j == samplerIndex)
+            {
+                color = textureGrad(sampler2DArray(textures[i], samplers[j]), coord, dx, dy);
+            }
+        }
+    }
+    return color;
+}
+#else
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2DArray textures[];
+layout(set = 0, binding = 1) uniform sampler samplers[NUM_SAMPLERS];
+
+vec4 sampleTextureGrad(uint textureIndex, uint samplerIndex, vec2 texCoord, vec2 dx, vec2 dy)
+{
+    return textureGrad(sampler2DArray(textures[nonuniformEXT(textureIndex >> 16)], samplers[nonuniformEXT(samplerIndex)]), vec3(texCoord, float(textureIndex & 0xFFFFu)), dx, dy);
+}
+#endif
+
+vec4 sampleTexture(uint textureIndex, uint samplerIndex, vec2 texCoord)
+{
+    return sampleTextureGrad(textureIndex, samplerIndex, texCoord, dFdx(texCoord), dFdy(texCoord));
+}
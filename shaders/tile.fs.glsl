@@ -0,0 +1,54 @@
+#version 450 core
+#extension GL_GOOGLE_include_directive : require
+
+#include "color.glsl"
+#include "textures.glsl"
+
+const uint emptyTile = 0xFFFFFFFFu;
+// eng::Sampler::Nearest
+const uint tileSampler = 0;
+
+layout(location = 0) in vec2 tileCoord;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std430, set = 2, binding = 0) readonly buffer TileData
+{
+    uint tiles[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    vec2 positionOffset;
+    vec2 position;
+    uint width;
+    uint height;
+    uint backgroundTextureIndex;
+};
+
+void main()
+{
+    // gradients are taken from the continuous coordinate so tile seams don't select the wrong mip
+    const vec2 dx = dFdx(tileCoord);
+    const vec2 dy = dFdy(tileCoord);
+
+    vec4 color = vec4(0);
+    if (backgroundTextureIndex != emptyTile)
+    {
+        color = sampleTextureGrad(backgroundTextureIndex, tileSampler, tileCoord, dx, dy);
+    }
+
+    const uvec2 cell = min(uvec2(tileCoord), uvec2(width, height) - 1);
+    const uint tile = tiles[cell.y * width + cell.x];
+    if (tile != emptyTile)
+    {
+        const vec4 tileColor = sampleTextureGrad(tile, tileSampler, fract(tileCoord), dx, dy);
+        color = vec4(mix(color.rgb, tileColor.rgb, tileColor.a), max(color.a, tileColor.a));
+    }
+
+    if (color.a == 0)
+    {
+        discard;
+    }
+    fragColor = encodeOutput(color);
+}
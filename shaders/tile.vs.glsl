@@ -0,0 +1,27 @@
+#version 450 core
+
+const vec2[4] corners = vec2[4](vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(-0.5, 0.5), vec2(0.5, 0.5));
+const vec2[4] cornerTexCoords = vec2[4](vec2(0, 1), vec2(1, 1), vec2(0, 0), vec2(1, 0));
+
+layout(location = 0) out vec2 tileCoord;
+
+layout(set = 1, binding = 0) uniform Matrices
+{
+    mat4 projection;
+};
+
+layout(push_constant) uniform PushConstants
+{
+    vec2 positionOffset;
+    vec2 position;
+    uint width;
+    uint height;
+    uint backgroundTextureIndex;
+};
+
+void main()
+{
+    const vec2 size = vec2(width, height);
+    tileCoord = size * cornerTexCoords[gl_VertexIndex];
+    gl_Position = projection * vec4(position + positionOffset + size * corners[gl_VertexIndex], 0, 1);
+}
@@ -0,0 +1,190 @@
+#include "simulation_thread.hpp"
+#include "profiler.hpp"
+#include "texture_loader.hpp"
+
+#include <algorithm>
+
+using eng::SimulationThread;
+
+SimulationThread::SimulationThread(GameLogicInterface& gameLogic, Scene& scene, TextureLoader& textureLoader, const InputManager& input, InputEventQueue& inputEvents, const double tickInterval, const std::string& inputRecordingPath) :
+    gameLogic(gameLogic),
+    scene(scene),
+    textureLoader(textureLoader),
+    tickInterval(tickInterval),
+    input(input),
+    inputEvents(inputEvents),
+    publishedFramebufferSize(scene.framebufferSize_)
+{
+    if (!inputRecordingPath.empty())
+    {
+        inputRecorder.emplace(inputRecordingPath, tickInterval);
+    }
+    const auto time = std::chrono::steady_clock::now();
+    tick(time);
+    // the first tick is also what it gets interpolated from
+    snapshots[readIndex] = snapshots[pendingIndex];
+    thread = std::jthread([this, time](std::stop_token stopToken) { run(stopToken, time); });
+}
+
+SimulationThread::~SimulationThread()
+{
+    thread.request_stop();
+    thread.join();
+}
+
+void SimulationThread::publishFramebufferSize(const std::pair<uint32_t, uint32_t> framebufferSize)
+{
+    std::lock_guard lock(mutex);
+    publishedFramebufferSize = framebufferSize;
+}
+
+void SimulationThread::updateScene(Scene& renderScene, const std::chrono::steady_clock::time_point now)
+{
+    if (failed)
+    {
+        std::lock_guard lock(mutex);
+        std::rethrow_exception(exception);
+    }
+
+    bool fresh;
+    {
+        std::lock_guard lock(mutex);
+        fresh = pendingFresh;
+    }
+    if (fresh)
+    {
+        // the simulation thread never writes the read slot, so the tick being replaced can be copied without the lock
+        previousInstances = snapshots[readIndex].instances;
+        previousInstanceKeys = snapshots[readIndex].instanceKeys;
+        previousRetainedInstanceOffset = snapshots[readIndex].retainedInstanceOffset;
+        {
+            std::lock_guard lock(mutex);
+            std::swap(readIndex, pendingIndex);
+            pendingFresh = false;
+        }
+        applySnapshot(renderScene, snapshots[readIndex]);
+    }
+
+    const SceneSnapshot& current = snapshots[readIndex];
+    const float alpha = std::clamp<float>(std::chrono::duration<double>(now - current.time).count() / tickInterval, 0, 1);
+
+    // Instances are matched by index, which only holds while the layer's keys didn't change. A pool removal moves
+    // another entity into the freed slot, so an equal count alone doesn't mean the same instances.
+    renderScene.instances_ = current.instances;
+    for (uint32_t layer = 0; layer < SceneInterface::numInstanceLayers; ++layer)
+    {
+        auto& instances = renderScene.instances_[layer];
+        const auto& previousLayer = previousInstances[layer];
+        const auto& keys = current.instanceKeys[layer];
+        if (previousLayer.size() == instances.size() && keys.size() == instances.size() && keys == previousInstanceKeys[layer])
+        {
+            for (size_t i = 0; i < instances.size(); ++i)
+            {
+                instances[i].position = glm::mix(previousLayer[i].position, instances[i].position, alpha);
+                instances[i].scale = glm::mix(previousLayer[i].scale, instances[i].scale, alpha);
+                instances[i].tintColor = glm::mix(previousLayer[i].tintColor, instances[i].tintColor, alpha);
+            }
+        }
+    }
+    renderScene.retainedInstanceOffset_ = glm::mix(previousRetainedInstanceOffset, current.retainedInstanceOffset, alpha);
+}
+
+std::vector<std::byte> SimulationThread::takeRequestedSnapshot()
+{
+    std::lock_guard lock(mutex);
+    return std::exchange(requestedSnapshot, {});
+}
+
+void SimulationThread::run(std::stop_token stopToken, std::chrono::steady_clock::time_point tickTime)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickInterval));
+    try
+    {
+        while (!stopToken.stop_requested())
+        {
+            tickTime += interval;
+            // after a long stall carry on from now instead of catching up with a burst of ticks
+            if (const auto now = Clock::now(); now - tickTime > 4 * interval)
+            {
+                tickTime = now;
+            }
+            std::this_thread::sleep_until(tickTime);
+            tick(tickTime);
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard lock(mutex);
+        exception = std::current_exception();
+        failed = true;
+    }
+}
+
+void SimulationThread::tick(const std::chrono::steady_clock::time_point time)
+{
+    input.handleEvents(inputEvents, time, [this](const InputEvent& event)
+        {
+            if (inputRecorder)
+            {
+                inputRecorder->record(tickIndex, event);
+            }
+        });
+    {
+        std::lock_guard lock(mutex);
+        scene.framebufferSize_ = publishedFramebufferSize;
+    }
+    {
+        ProfileScope scope("tick");
+        gameLogic.runFrame(scene, input, tickInterval);
+    }
+    input.nextFrame();
+    ++tickIndex;
+    if (auto requested = gameLogic.takeRequestedSnapshot(); !requested.empty())
+    {
+        std::lock_guard lock(mutex);
+        requestedSnapshot = std::move(requested);
+    }
+
+    // the write slot belongs to this thread until it is swapped out below
+    SceneSnapshot& snapshot = snapshots[writeIndex];
+    snapshot.time = time;
+    snapshot.instances = scene.instances_;
+    snapshot.instanceKeys = scene.instanceKeys_;
+    snapshot.retainedInstances = scene.retainedInstances_.instances;
+    snapshot.retainedDirtyRange = scene.retainedInstances_.takeDirtyRange();
+    if (snapshot.tileMapVersion != scene.tileMapVersion_)
+    {
+        snapshot.tileMap = scene.tileMap_;
+        snapshot.tileMapVersion = scene.tileMapVersion_;
+    }
+    snapshot.retainedInstanceOffset = scene.retainedInstanceOffset_;
+    snapshot.projection = scene.projection_;
+    snapshot.viewportOffset = scene.viewportOffset_;
+    snapshot.viewportExtent = scene.viewportExtent_;
+    snapshot.textureUnloads = textureLoader.unloads();
+
+    std::lock_guard lock(mutex);
+    if (pendingFresh)
+    {
+        // the render thread never saw the pending tick, so its retained changes are carried over
+        const auto [pendingBegin, pendingEnd] = snapshots[pendingIndex].retainedDirtyRange;
+        snapshot.retainedDirtyRange.first = std::min(snapshot.retainedDirtyRange.first, pendingBegin);
+        snapshot.retainedDirtyRange.second = std::max(snapshot.retainedDirtyRange.second, pendingEnd);
+    }
+    std::swap(writeIndex, pendingIndex);
+    pendingFresh = true;
+}
+
+void SimulationThread::applySnapshot(Scene& renderScene, const SceneSnapshot& snapshot)
+{
+    renderScene.retainedInstances_.mirror(snapshot.retainedInstances, snapshot.retainedDirtyRange);
+    if (renderScene.tileMapVersion_ != snapshot.tileMapVersion)
+    {
+        renderScene.tileMap_ = snapshot.tileMap;
+        renderScene.tileMapVersion_ = snapshot.tileMapVersion;
+    }
+    renderScene.projection_ = snapshot.projection;
+    renderScene.viewportOffset_ = snapshot.viewportOffset;
+    renderScene.viewportExtent_ = snapshot.viewportExtent;
+}
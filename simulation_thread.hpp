@@ -0,0 +1,106 @@
+#pragma once
+
+#include "engine.hpp"
+#include "gpu_instance.hpp"
+#include "input_manager.hpp"
+#include "input_recording.hpp"
+#include "scene.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace eng
+{
+    struct TextureLoader;
+
+    // Everything the render thread needs from one simulation tick.
+    struct SceneSnapshot
+    {
+        std::chrono::steady_clock::time_point time;
+        SceneInterface::InstanceLayers instances;
+        SceneInterface::InstanceKeyLayers instanceKeys;
+        // full copy of the simulation's retained slots, only the ones in the dirty range changed since the last consumed snapshot
+        std::vector<GpuInstance> retainedInstances;
+        std::pair<uint32_t, uint32_t> retainedDirtyRange;
+        TileMap tileMap;
+        uint32_t tileMapVersion = 0;
+        glm::vec2 retainedInstanceOffset = { 0, 0 };
+        glm::mat4 projection;
+        glm::vec2 viewportOffset;
+        glm::vec2 viewportExtent;
+        // TextureLoader::unloads after the tick, the textures unloaded by then aren't drawn by it
+        uint64_t textureUnloads = 0;
+    };
+
+    // Calls GameLogicInterface::runFrame every tickInterval seconds on its own thread, so simulation keeps its pace while
+    // the render thread waits on fences or vsync. Ticks are handed over through a triple buffer and the render thread
+    // draws one tick behind, interpolating between the last two.
+    class SimulationThread
+    {
+    public:
+        // Takes over scene, which must not be touched by anybody else until the thread is destroyed. Input mappings have
+        // to be created before this, the thread keeps a copy of input and becomes the consumer of inputEvents, draining
+        // the events up to each tick's time before running it. The first tick runs on the calling thread, so there is
+        // always a snapshot to draw. The consumed input is recorded by tick to inputRecordingPath unless it is empty.
+        explicit SimulationThread(GameLogicInterface& gameLogic, Scene& scene, TextureLoader& textureLoader, const InputManager& input, InputEventQueue& inputEvents, const double tickInterval, const std::string& inputRecordingPath);
+        ~SimulationThread();
+
+        SimulationThread(const SimulationThread&) = delete;
+        SimulationThread& operator=(const SimulationThread&) = delete;
+
+        // Render thread: hands the latest framebuffer size to the next tick.
+        void publishFramebufferSize(const std::pair<uint32_t, uint32_t> framebufferSize);
+
+        // Render thread: takes in the newest tick if there is one and fills renderScene with the state at now.
+        // Rethrows exceptions thrown by runFrame on the simulation thread.
+        void updateScene(Scene& renderScene, const std::chrono::steady_clock::time_point now);
+
+        // Render thread: the last snapshot the game requested that wasn't taken yet, empty if there is none.
+        std::vector<std::byte> takeRequestedSnapshot();
+
+        // Render thread: TextureLoader::unloads as of the tick renderScene was last filled from, the textures unloaded by
+        // then can be released.
+        uint64_t drawnTextureUnloads() const { return snapshots[readIndex].textureUnloads; }
+
+    private:
+        void run(std::stop_token stopToken, std::chrono::steady_clock::time_point tickTime);
+        void tick(const std::chrono::steady_clock::time_point time);
+        void applySnapshot(Scene& renderScene, const SceneSnapshot& snapshot);
+
+        GameLogicInterface& gameLogic;
+        Scene& scene;
+        TextureLoader& textureLoader;
+        const double tickInterval;
+        InputManager input;
+        InputEventQueue& inputEvents;
+        std::optional<InputRecorder> inputRecorder;
+        uint64_t tickIndex = 0;
+
+        std::mutex mutex;
+        std::pair<uint32_t, uint32_t> publishedFramebufferSize;
+        std::array<SceneSnapshot, 3> snapshots;
+        uint32_t writeIndex = 0;
+        uint32_t pendingIndex = 1;
+        uint32_t readIndex = 2;
+        bool pendingFresh = false;
+        std::vector<std::byte> requestedSnapshot;
+        std::exception_ptr exception;
+        std::atomic<bool> failed = false;
+
+        // render thread only
+        SceneInterface::InstanceLayers previousInstances;
+        SceneInterface::InstanceKeyLayers previousInstanceKeys;
+        glm::vec2 previousRetainedInstanceOffset = { 0, 0 };
+
+        std::jthread thread;
+    };
+}
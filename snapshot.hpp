@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binary snapshots of simulation state. A type either has a serialize(archive) member that passes its fields to
+// archive(...), or is trivially copyable and stored as its bytes, and the same member both writes and reads, so the two
+// can't drift apart. Pointers to data outside the snapshot (texture sets, animation sequences) go through
+// archive.pointer(), which stores their index in a table both sides build in the same order. Structs with padding
+// need a serialize member too, or equal states won't give equal snapshots. Empty types take no space. Snapshots are
+// only meant to be read back by the same build on the same platform.
+namespace snapshot
+{
+    constexpr uint32_t None = std::numeric_limits<uint32_t>::max();
+
+    template<typename Derived>
+    struct Archive
+    {
+        std::vector<const void*> pointers;
+
+        template<typename... Types>
+        void operator()(Types&... values)
+        {
+            (item(values), ...);
+        }
+
+        template<typename T>
+        void pointer(const T*& value)
+        {
+            uint32_t index = None;
+            if constexpr (!Derived::reading)
+            {
+                if (value)
+                {
+                    const auto found = std::find(pointers.begin(), pointers.end(), value);
+                    if (found == pointers.end())
+                    {
+                        throw std::runtime_error("Pointer isn't registered with the snapshot");
+                    }
+                    index = found - pointers.begin();
+                }
+            }
+            item(index);
+            if constexpr (Derived::reading)
+            {
+                if (index != None && index >= pointers.size())
+                {
+                    throw std::runtime_error("Corrupt snapshot");
+                }
+                value = index == None ? nullptr : static_cast<const T*>(pointers[index]);
+            }
+        }
+
+    private:
+        template<typename T>
+        static constexpr bool raw = std::is_trivially_copyable_v<T> && !requires(T& value, Derived& archive) { value.serialize(archive); };
+
+        Derived& derived()
+        {
+            return static_cast<Derived&>(*this);
+        }
+
+        template<typename T>
+        void item(T& value)
+        {
+            if constexpr (std::is_empty_v<T>)
+            {
+            }
+            else if constexpr (raw<T>)
+            {
+                derived().bytes(&value, sizeof(T));
+            }
+            else
+            {
+                value.serialize(derived());
+            }
+        }
+
+        template<typename First, typename Second>
+        void item(std::pair<First, Second>& value)
+        {
+            item(value.first);
+            item(value.second);
+        }
+
+        template<typename T, size_t Size>
+        void item(std::array<T, Size>& values)
+        {
+            for (auto& value : values)
+            {
+                item(value);
+            }
+        }
+
+        template<typename Container>
+        void sequence(Container& values)
+        {
+            uint64_t size = values.size();
+            item(size);
+            if constexpr (Derived::reading)
+            {
+                // stored elements take at least a byte, so a bad size fails here rather than in resize
+                derived().require(std::is_empty_v<typename Container::value_type> ? 0 : size);
+                values.resize(size);
+            }
+        }
+
+        template<typename T>
+        void item(std::vector<T>& values)
+        {
+            sequence(values);
+            if constexpr (std::is_empty_v<T>)
+            {
+            }
+            else if constexpr (raw<T>)
+            {
+                derived().bytes(values.data(), values.size() * sizeof(T));
+            }
+            else
+            {
+                for (auto& value : values)
+                {
+                    item(value);
+                }
+            }
+        }
+
+        template<typename T>
+        void item(std::deque<T>& values)
+        {
+            sequence(values);
+            for (auto& value : values)
+            {
+                item(value);
+            }
+        }
+
+        void item(std::string& value)
+        {
+            sequence(value);
+            derived().bytes(value.data(), value.size());
+        }
+    };
+
+    struct Writer : Archive<Writer>
+    {
+        static constexpr bool reading = false;
+
+        std::vector<std::byte> data;
+
+        void bytes(const void* source, const size_t size)
+        {
+            const auto begin = static_cast<const std::byte*>(source);
+            data.insert(data.end(), begin, begin + size);
+        }
+    };
+
+    struct Reader : Archive<Reader>
+    {
+        static constexpr bool reading = true;
+
+        std::span<const std::byte> data;
+        size_t offset = 0;
+
+        explicit Reader(std::span<const std::byte> data) :
+            data(data)
+        {
+        }
+
+        void require(const size_t size) const
+        {
+            if (data.size() - offset < size)
+            {
+                throw std::runtime_error("Truncated snapshot");
+            }
+        }
+
+        void bytes(void* destination, const size_t size)
+        {
+            require(size);
+            std::copy_n(data.begin() + offset, size, static_cast<std::byte*>(destination));
+            offset += size;
+        }
+
+        bool done() const
+        {
+            return offset == data.size();
+        }
+    };
+
+    // FNV-1a, for comparing the end states of two runs
+    inline uint64_t hash(std::span<const std::byte> data)
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (const std::byte byte : data)
+        {
+            hash = (hash ^ static_cast<uint64_t>(byte)) * 0x100000001b3;
+        }
+        return hash;
+    }
+}
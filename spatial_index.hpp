@@ -0,0 +1,178 @@
+#pragma once
+
+#include "ecs.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Which entities are in which cell of a width x height grid. An entity is in at most one cell, so the list nodes live
+// in one array indexed by entity index and link the occupants of a cell in insertion order. Each cell also keeps the
+// OR of its occupants' component masks, so "is anything solid here" is a single bit test.
+struct SpatialIndex
+{
+    constexpr static uint32_t None = std::numeric_limits<uint32_t>::max();
+
+    struct Node
+    {
+        uint32_t entity = Entity::Invalid;
+        uint32_t cell = None;
+        uint32_t prev = None;
+        uint32_t next = None;
+        uint32_t mask = 0;
+    };
+
+    struct CellList
+    {
+        uint32_t head = None;
+        uint32_t tail = None;
+        uint32_t mask = 0;
+    };
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<CellList> cells;
+    // by entity index
+    std::vector<Node> nodes;
+    // called with the cell's new mask whenever it changes
+    std::function<void(uint32_t x, uint32_t y, uint32_t mask)> onCellMaskChanged;
+
+    template<typename Archive>
+    void serialize(Archive& archive)
+    {
+        archive(width, height, cells, nodes);
+    }
+
+    void reset(const uint32_t width, const uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        cells.assign(width * height, CellList {});
+        nodes.clear();
+    }
+
+    // moves the entity to the end of the cell's list if it already is in another cell
+    void insert(const uint32_t entity, const uint32_t x, const uint32_t y)
+    {
+        remove(entity);
+        const uint32_t index = Entity::index(entity);
+        Node& node = nodeAt(index);
+        CellList& cell = cells.at(y * width + x);
+        node.entity = entity;
+        node.cell = y * width + x;
+        node.prev = cell.tail;
+        node.next = None;
+        if (cell.tail != None)
+        {
+            nodes[cell.tail].next = index;
+        }
+        else
+        {
+            cell.head = index;
+        }
+        cell.tail = index;
+        setCellMask(node.cell, cell.mask | node.mask);
+    }
+
+    void remove(const uint32_t entity)
+    {
+        const uint32_t index = Entity::index(entity);
+        if (index >= nodes.size() || nodes[index].cell == None || nodes[index].entity != entity)
+        {
+            return;
+        }
+        Node& node = nodes[index];
+        const uint32_t cellIndex = node.cell;
+        CellList& cell = cells[cellIndex];
+        (node.prev != None ? nodes[node.prev].next : cell.head) = node.next;
+        (node.next != None ? nodes[node.next].prev : cell.tail) = node.prev;
+        node.cell = node.prev = node.next = None;
+        updateCellMask(cellIndex);
+    }
+
+    void setMask(const uint32_t entity, const uint32_t mask)
+    {
+        Node& node = nodeAt(Entity::index(entity));
+        node.mask = mask;
+        if (node.cell != None && node.entity == entity)
+        {
+            updateCellMask(node.cell);
+        }
+    }
+
+    uint32_t mask(const uint32_t x, const uint32_t y) const
+    {
+        return cells[y * width + x].mask;
+    }
+
+    uint32_t occupantMask(const uint32_t entity) const
+    {
+        return nodes[Entity::index(entity)].mask;
+    }
+
+    // Calls fn(entity, mask) for the occupants in insertion order until it returns true.
+    template<typename Callable>
+    bool forEachOccupant(const uint32_t x, const uint32_t y, Callable&& fn) const
+    {
+        for (uint32_t index = cells[y * width + x].head; index != None; index = nodes[index].next)
+        {
+            if (fn(nodes[index].entity, nodes[index].mask))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // first occupant with any of the bits in mask set, or Entity::Invalid
+    uint32_t findOccupant(const uint32_t x, const uint32_t y, const uint32_t mask) const
+    {
+        uint32_t found = Entity::Invalid;
+        if (this->mask(x, y) & mask)
+        {
+            forEachOccupant(x, y, [&](const uint32_t entity, const uint32_t occupantMask)
+                {
+                    if (occupantMask & mask)
+                    {
+                        found = entity;
+                        return true;
+                    }
+                    return false;
+                });
+        }
+        return found;
+    }
+
+private:
+    Node& nodeAt(const uint32_t index)
+    {
+        if (nodes.size() <= index)
+        {
+            nodes.resize(index + 1);
+        }
+        return nodes[index];
+    }
+
+    void updateCellMask(const uint32_t cellIndex)
+    {
+        uint32_t mask = 0;
+        for (uint32_t index = cells[cellIndex].head; index != None; index = nodes[index].next)
+        {
+            mask |= nodes[index].mask;
+        }
+        setCellMask(cellIndex, mask);
+    }
+
+    void setCellMask(const uint32_t cellIndex, const uint32_t mask)
+    {
+        if (cells[cellIndex].mask != mask)
+        {
+            cells[cellIndex].mask = mask;
+            if (onCellMaskChanged)
+            {
+                onCellMaskChanged(cellIndex % width, cellIndex / width, mask);
+            }
+        }
+    }
+};
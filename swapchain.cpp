@@ -1,11 +1,51 @@
 #include "swapchain.hpp"
+#include "gpu_timeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
 
 using eng::Swapchain;
 
-static vk::raii::SwapchainKHR createSwapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent, const vk::SwapchainKHR& oldSwapchain)
+static vk::PresentModeKHR getPresentMode(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, eng::PresentMode presentMode)
+{
+    const auto presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
+    const auto supported = [&](const vk::PresentModeKHR mode)
+    {
+        return std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end();
+    };
+
+    // Fifo is the only mode every implementation has to support
+    switch (presentMode)
+    {
+    case eng::PresentMode::Immediate:
+        if (supported(vk::PresentModeKHR::eImmediate))
+        {
+            return vk::PresentModeKHR::eImmediate;
+        }
+        [[fallthrough]];
+    case eng::PresentMode::Mailbox:
+        if (supported(vk::PresentModeKHR::eMailbox))
+        {
+            return vk::PresentModeKHR::eMailbox;
+        }
+        break;
+    case eng::PresentMode::FifoRelaxed:
+        if (supported(vk::PresentModeKHR::eFifoRelaxed))
+        {
+            return vk::PresentModeKHR::eFifoRelaxed;
+        }
+        break;
+    case eng::PresentMode::Fifo:
+        break;
+    }
+    return vk::PresentModeKHR::eFifo;
+}
+
+static vk::raii::SwapchainKHR createSwapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent, const vk::PresentModeKHR presentMode, const uint32_t imageCount, const vk::SwapchainKHR& oldSwapchain)
 {
     const auto surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
-    uint32_t minImageCount = std::max(surfaceCapabilities.minImageCount, 4u);
+    uint32_t minImageCount = std::max(surfaceCapabilities.minImageCount, imageCount);
     if (surfaceCapabilities.maxImageCount > 0)
     {
         minImageCount = std::min(minImageCount, surfaceCapabilities.maxImageCount);
@@ -22,18 +62,21 @@ static vk::raii::SwapchainKHR createSwapchain(const vk::raii::Device& device, co
         .imageSharingMode = vk::SharingMode::eExclusive,
         .preTransform = surfaceCapabilities.currentTransform,
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        .presentMode = vk::PresentModeKHR::eFifo,
+        .presentMode = presentMode,
         .clipped = vk::True,
         .oldSwapchain = oldSwapchain,
     });
 }
 
-Swapchain::Swapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent) :
+Swapchain::Swapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent, const PresentMode presentMode, const uint32_t imageCount, const bool presentWaitEnabled) :
     device(device),
     physicalDevice(physicalDevice),
     surface(surface),
     surfaceFormat(surfaceFormat),
-    swapchain(createSwapchain(device, physicalDevice, surface, surfaceFormat, extent, vk::SwapchainKHR{})),
+    presentMode(getPresentMode(physicalDevice, surface, presentMode)),
+    imageCount(imageCount),
+    presentWaitEnabled(presentWaitEnabled),
+    swapchain(createSwapchain(device, physicalDevice, surface, surfaceFormat, extent, this->presentMode, imageCount, vk::SwapchainKHR{})),
     images(swapchain.getImages()),
     extent(extent)
 {
@@ -49,10 +92,17 @@ Swapchain::Swapchain(const vk::raii::Device& device, const vk::raii::PhysicalDev
     }
 }
 
-void Swapchain::recreate(const vk::Extent2D& extent)
+void Swapchain::recreate(const vk::Extent2D& extent, GpuTimeline& timeline)
 {
     this->extent = extent;
-    swapchain = createSwapchain(device, physicalDevice, surface, surfaceFormat, extent, swapchain);
+    auto newSwapchain = createSwapchain(device, physicalDevice, surface, surfaceFormat, extent, presentMode, imageCount, *swapchain);
+    timeline.retire(Retired {
+            .swapchain = std::move(swapchain),
+            .imageViews = std::move(imageViews),
+        });
+    swapchain = std::move(newSwapchain);
+    lastPresentId = 0;
+    outOfDate = false;
     images = swapchain.getImages();
     imageViews.clear();
     imageViews.reserve(images.size());
@@ -66,3 +116,17 @@ void Swapchain::recreate(const vk::Extent2D& extent)
         }));
     }
 }
+
+void Swapchain::waitForPresent(const uint64_t presentId, const uint64_t timeout) const
+{
+    if (!presentWaitEnabled || presentId == 0 || presentId > lastPresentId)
+    {
+        return;
+    }
+    // a timeout just means the frame is late and an out of date swapchain is about to be recreated, the caller carries on either way
+    const auto result = static_cast<vk::Result>(device.getDispatcher()->vkWaitForPresentKHR(*device, *swapchain, presentId, timeout));
+    if (result != vk::Result::eSuccess && result != vk::Result::eTimeout && result != vk::Result::eSuboptimalKHR && result != vk::Result::eErrorOutOfDateKHR)
+    {
+        throw std::runtime_error("Unexpected return from waitForPresentKHR");
+    }
+}
@@ -1,22 +1,43 @@
 #pragma once
 
+#include "engine.hpp"
 #include "vulkan_includes.hpp"
 
 namespace eng
 {
+    struct GpuTimeline;
+
     struct Swapchain
     {
-        explicit Swapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent);
+        struct Retired
+        {
+            vk::raii::SwapchainKHR swapchain;
+            std::vector<vk::raii::ImageView> imageViews;
+        };
+
+        explicit Swapchain(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface, const vk::SurfaceFormatKHR& surfaceFormat, const vk::Extent2D& extent, const PresentMode presentMode, const uint32_t imageCount, const bool presentWaitEnabled);
+
+        // The old swapchain may still be used by submitted frames, it's handed to timeline to be destroyed after them.
+        void recreate(const vk::Extent2D& extent, GpuTimeline& timeline);
 
-        void recreate(const vk::Extent2D& extent);
+        // Blocks until the present with the given id is on screen or the timeout runs out. Does nothing without present
+        // wait or when the id wasn't presented to the current swapchain.
+        void waitForPresent(const uint64_t presentId, const uint64_t timeout) const;
 
         const vk::raii::Device& device;
         const vk::raii::PhysicalDevice& physicalDevice;
         const vk::raii::SurfaceKHR& surface;
         const vk::SurfaceFormatKHR surfaceFormat;
+        const vk::PresentModeKHR presentMode;
+        const uint32_t imageCount;
+        const bool presentWaitEnabled;
         vk::raii::SwapchainKHR swapchain;
         std::vector<vk::Image> images;
         std::vector<vk::raii::ImageView> imageViews;
         vk::Extent2D extent;
+        // ids passed with vk::PresentIdKHR, they have to increase per swapchain so they restart on recreate
+        uint64_t lastPresentId = 0;
+        // set on suboptimal or out of date results, the owner recreates the swapchain before the next frame
+        bool outOfDate = false;
     };
 }
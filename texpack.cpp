@@ -0,0 +1,108 @@
+// Offline texture pack builder: texpack <output> <name prefix> <input files...>
+// Entries are named <name prefix><input file name> so they match the paths the game passes to loadTexture.
+
+#include "mip_chain.hpp"
+#include "texture_pack.hpp"
+#include <stb_image.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace texture_pack = eng::texture_pack;
+
+static uint64_t alignUp(const uint64_t value, const uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <output> <name prefix> <input files...>" << std::endl;
+        return 1;
+    }
+
+    const std::string outputPath = argv[1];
+    const std::string namePrefix = argv[2];
+    const uint32_t numEntries = argc - 3;
+
+    std::vector<texture_pack::Entry> entries;
+    std::vector<std::vector<std::byte>> pixels;
+    std::string names;
+    entries.reserve(numEntries);
+    pixels.reserve(numEntries);
+
+    for (int i = 3; i < argc; ++i)
+    {
+        int width, height, components;
+        stbi_uc* textureData = stbi_load(argv[i], &width, &height, &components, 4);
+        if (!textureData)
+        {
+            std::cerr << "Failed to load texture: " << argv[i] << ": " << stbi_failure_reason() << std::endl;
+            return 1;
+        }
+        const uint32_t mipLevels = eng::fullMipLevels(width, height);
+        const uint64_t dataSize = eng::mipChainSize(width, height, mipLevels, 4);
+        auto& mipChain = pixels.emplace_back(dataSize);
+        std::memcpy(mipChain.data(), textureData, static_cast<size_t>(width) * height * 4);
+        stbi_image_free(textureData);
+        eng::generateMipChain(mipChain.data(), width, height, mipLevels);
+
+        const std::string name = namePrefix + std::filesystem::path(argv[i]).filename().string();
+        entries.push_back(texture_pack::Entry {
+                .nameOffset = static_cast<uint32_t>(names.size()),
+                .nameLength = static_cast<uint32_t>(name.size()),
+                .width = static_cast<uint32_t>(width),
+                .height = static_cast<uint32_t>(height),
+                .format = texture_pack::formatR8G8B8A8Srgb,
+                .mipLevels = mipLevels,
+                .dataOffset = 0,
+                .dataSize = dataSize,
+            });
+        names += name;
+    }
+
+    const texture_pack::Header header {
+        .magic = texture_pack::magic,
+        .version = texture_pack::version,
+        .numEntries = numEntries,
+        .stringTableSize = static_cast<uint32_t>(names.size()),
+    };
+
+    uint64_t offset = sizeof(header) + numEntries * sizeof(texture_pack::Entry) + names.size();
+    for (auto& entry : entries)
+    {
+        offset = alignUp(offset, texture_pack::dataAlignment);
+        entry.dataOffset = offset;
+        offset += entry.dataSize;
+    }
+
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output)
+    {
+        std::cerr << "Failed to open output: " << outputPath << std::endl;
+        return 1;
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(texture_pack::Entry));
+    output.write(names.data(), names.size());
+    for (uint32_t i = 0; i < numEntries; ++i)
+    {
+        const uint64_t padding = entries[i].dataOffset - static_cast<uint64_t>(output.tellp());
+        const char zeros[texture_pack::dataAlignment] = {};
+        output.write(zeros, padding);
+        output.write(reinterpret_cast<const char*>(pixels[i].data()), pixels[i].size());
+    }
+
+    if (!output)
+    {
+        std::cerr << "Failed to write output: " << outputPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
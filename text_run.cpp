@@ -0,0 +1,55 @@
+#include "text_run.hpp"
+
+#include <iterator>
+#include <utility>
+
+using namespace eng;
+
+void eng::layoutTextRun(const TextRun& run, const Font& font, std::vector<Instance>& instances)
+{
+    const float advance = font.glyphAspect * run.scale.x;
+    const glm::vec2 texCoordScale = { 1.0f / font.columns, 1.0f / font.rows };
+    instances.reserve(instances.size() + run.text.size() + 1);
+    instances.push_back(Instance {
+            .position = { run.position.x + 0.5f * advance * run.text.size(), run.position.y },
+            .scale = { advance * run.text.size(), run.scale.y },
+            .textureIndex = font.backgroundTextureIndex,
+            .tintColor = run.background,
+            .sampler = run.sampler,
+        });
+    for (uint32_t i = 0; i < run.text.size(); ++i)
+    {
+        const auto glyph = static_cast<unsigned char>(run.text[i]);
+        instances.push_back(Instance {
+                .position = { run.position.x + (i + 0.5f) * advance, run.position.y },
+                .scale = { advance, run.scale.y },
+                .minTexCoord = glm::vec2(glyph / font.rows, glyph % font.rows) * texCoordScale,
+                .texCoordScale = texCoordScale,
+                .textureIndex = font.textureIndex,
+                .tintColor = run.foreground,
+                .sampler = run.sampler,
+            });
+    }
+}
+
+void TextRunCache::draw(const uint32_t key, const TextRun& run, std::vector<Instance>& instances)
+{
+    auto [it, inserted] = entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted || entry.run != run)
+    {
+        entry.run = run;
+        entry.instances.clear();
+        layoutTextRun(run, font, entry.instances);
+    }
+    entry.drawn = true;
+    instances.insert(instances.end(), entry.instances.begin(), entry.instances.end());
+}
+
+void TextRunCache::collect()
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        it = std::exchange(it->second.drawn, false) ? std::next(it) : entries.erase(it);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace eng
+{
+    // A monospace font in a grid texture. Glyph c is in column c / rows and row c % rows.
+    struct Font
+    {
+        uint32_t textureIndex = 0;
+        // stretched behind the run, a texture that is white everywhere
+        uint32_t backgroundTextureIndex = 0;
+        uint32_t columns = 16;
+        uint32_t rows = 8;
+        // glyph width and advance relative to the height
+        float glyphAspect = 0.5f;
+    };
+
+    // One line of text. position is the left end of the run at half its height.
+    struct TextRun
+    {
+        std::string text;
+        glm::vec2 position = { 0, 0 };
+        glm::vec2 scale = { 1, 1 };
+        glm::vec4 background = { 0, 0, 0, 0 };
+        glm::vec4 foreground = { 1, 1, 1, 1 };
+        Sampler sampler = Sampler::Nearest;
+
+        bool operator==(const TextRun&) const = default;
+
+        template<typename Archive>
+        void serialize(Archive& archive)
+        {
+            archive(text, position, scale, background, foreground, sampler);
+        }
+    };
+
+    // Appends a background quad and one instance per character.
+    void layoutTextRun(const TextRun& run, const Font& font, std::vector<Instance>& instances);
+
+    // Keeps the laid out instances of every run, so unchanged text costs a copy per frame instead of being laid out again.
+    struct TextRunCache
+    {
+        // Appends the instances of the run last drawn under key, laying it out again only if it differs.
+        void draw(const uint32_t key, const TextRun& run, std::vector<Instance>& instances);
+
+        // Drops the runs that weren't drawn since the last call, call once per frame after drawing.
+        void collect();
+
+        struct Entry
+        {
+            TextRun run;
+            std::vector<Instance> instances;
+            bool drawn = false;
+        };
+
+        Font font;
+        std::unordered_map<uint32_t, Entry> entries;
+    };
+}
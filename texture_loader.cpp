@@ -1,143 +1,541 @@
 #include "texture_loader.hpp"
+#include "gpu_timeline.hpp"
+#include "mip_chain.hpp"
+#include "thread_pool.hpp"
 #include <stb_image.h>
 
+#include <algorithm>
+#include <chrono>
+
 using eng::TextureLoader;
 
-TextureLoader::TextureLoader(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator) :
+static vk::raii::CommandBuffer allocateCommandBuffer(const vk::raii::Device& device, const vk::raii::CommandPool& commandPool)
+{
+    return std::move(device.allocateCommandBuffers(vk::CommandBufferAllocateInfo {
+                .commandPool = commandPool,
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1,
+            }).front());
+}
+
+TextureLoader::TextureLoader(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vk::raii::Queue& transferQueue, const uint32_t transferQueueFamilyIndex, const vma::Allocator& allocator, ThreadPool& threadPool, GpuTimeline& timeline, const PackingMode packingMode, const bool generateMipmaps, const uint32_t maxTextureArrays) :
     device(device),
     queue(queue),
+    transferQueue(transferQueue),
+    queueFamilyIndex(queueFamilyIndex),
+    transferQueueFamilyIndex(transferQueueFamilyIndex),
     allocator(allocator),
+    threadPool(threadPool),
+    timeline(timeline),
+    packingMode(packingMode),
+    generateMipmaps(generateMipmaps),
+    maxTextureArrays(std::min(maxTextureArrays, 1u << (32 - layerBits))),
     commandPool(device, vk::CommandPoolCreateInfo {
             // .flags = vk::CommandPoolCreateFlagBits::eTransient,
             .queueFamilyIndex = queueFamilyIndex,
         }),
-    commandBuffer(std::move(device.allocateCommandBuffers(vk::CommandBufferAllocateInfo {
-                .commandPool = commandPool,
-                .level = vk::CommandBufferLevel::ePrimary,
-                .commandBufferCount = 1,
-            }).front())),
-    fence(device, vk::FenceCreateInfo {})
+    commandBuffer(allocateCommandBuffer(device, commandPool)),
+    transferCommandPool(transferQueueFamilyIndex != queueFamilyIndex ? vk::raii::CommandPool(device, vk::CommandPoolCreateInfo {
+                .queueFamilyIndex = transferQueueFamilyIndex,
+            }) : vk::raii::CommandPool(nullptr)),
+    transferCommandBuffer(transferQueueFamilyIndex != queueFamilyIndex ? allocateCommandBuffer(device, transferCommandPool) : vk::raii::CommandBuffer(nullptr)),
+    transferSemaphore(transferQueueFamilyIndex != queueFamilyIndex ? vk::raii::Semaphore(device, vk::SemaphoreCreateInfo {}) : vk::raii::Semaphore(nullptr))
 {
-    commandBuffer.begin(vk::CommandBufferBeginInfo {
-            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
-        });
 }
 
-std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView> TextureLoader::loadTexture(const std::string& filePath, const vk::Format format, const int channels, const int bytesPerPixel)
+TextureLoader::~TextureLoader()
+{
+    // decode jobs write into the staging chunks, they must not outlive them
+    for (auto& decodeJob : decodeJobs)
+    {
+        if (decodeJob.valid())
+        {
+            decodeJob.wait();
+        }
+    }
+}
+
+void TextureLoader::openTexturePack(const std::string& filePath)
 {
+    texturePack.emplace(filePath);
+}
+
+uint32_t TextureLoader::loadTexture(const std::string& filePath, const vk::Format format, const int channels, const int bytesPerPixel)
+{
+    std::lock_guard lock(mutex);
+    if (texturePack)
+    {
+        const auto* entry = texturePack->find(filePath);
+        if (entry && entry->format == static_cast<uint32_t>(format) && entry->dataSize == mipChainSize(entry->width, entry->height, entry->mipLevels, bytesPerPixel))
+        {
+            // a pack with more levels than needed still works, the chain is stored largest first
+            const uint32_t mipLevels = getMipLevels(format, entry->width, entry->height);
+            if (entry->mipLevels >= mipLevels)
+            {
+                // already in the final format, so it goes straight from the mapping into staging memory
+                const vk::DeviceSize textureDataSize = mipChainSize(entry->width, entry->height, mipLevels, bytesPerPixel);
+                const auto [stagingChunkIndex, stagingOffset] = allocateStaging(textureDataSize);
+                std::memcpy(stagingChunks[stagingChunkIndex].mappedData + stagingOffset, texturePack->data(*entry), textureDataSize);
+                return addLayer(format, bytesPerPixel, entry->width, entry->height, mipLevels, stagingChunkIndex, stagingOffset);
+            }
+        }
+    }
+
     int width, height, components;
-    stbi_uc* textureData = stbi_load(filePath.c_str(), &width, &height, &components, channels);
-    if (!textureData)
+    if (!stbi_info(filePath.c_str(), &width, &height, &components))
     {
         throw std::runtime_error("Failed to load texture: " + filePath);
     }
 
-    const vk::DeviceSize textureDataSize = width * height * bytesPerPixel;
-    vma::AllocationInfo allocationInfo;
-    auto& [stagingBuffer, stagingBufferAllocation] = stagingBuffers.emplace_back(allocator.createBufferUnique(vk::BufferCreateInfo {
-            .size = textureDataSize,
-            .usage = vk::BufferUsageFlagBits::eTransferSrc,
-        }, vma::AllocationCreateInfo {
-            .flags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-            .usage = vma::MemoryUsage::eAuto,
-        }, allocationInfo));
+    const uint32_t mipLevels = getMipLevels(format, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    const vk::DeviceSize textureDataSize = mipChainSize(width, height, mipLevels, bytesPerPixel);
+    const auto [stagingChunkIndex, stagingOffset] = allocateStaging(textureDataSize);
+    std::byte* destination = stagingChunks[stagingChunkIndex].mappedData + stagingOffset;
 
-    std::memcpy(allocationInfo.pMappedData, textureData, textureDataSize);
-    stbi_image_free(textureData);
+    decodeJobs.push_back(threadPool.submit([filePath, channels, width, height, mipLevels, bytesPerPixel, textureDataSize, destination] {
+            int decodedWidth, decodedHeight, components;
+            stbi_uc* textureData = stbi_load(filePath.c_str(), &decodedWidth, &decodedHeight, &components, channels);
+            if (!textureData)
+            {
+                throw std::runtime_error("Failed to load texture: " + filePath);
+            }
+            if (decodedWidth != width || decodedHeight != height)
+            {
+                stbi_image_free(textureData);
+                throw std::runtime_error("Texture changed while loading: " + filePath);
+            }
 
-    auto [image, allocation] = allocator.createImageUnique(vk::ImageCreateInfo {
-            .imageType = vk::ImageType::e2D,
-            .format = format,
-            .extent = vk::Extent3D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 },
-            .mipLevels = 1, /* TODO: mip mapping */
-            .arrayLayers = 1,
-            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
-            .initialLayout = vk::ImageLayout::eUndefined,
-        }, vma::AllocationCreateInfo {
-            .usage = vma::MemoryUsage::eAuto,
-        });
+            if (mipLevels == 1)
+            {
+                std::memcpy(destination, textureData, textureDataSize);
+                stbi_image_free(textureData);
+                return;
+            }
 
-    const vk::ImageMemoryBarrier2 initialImageMemoryBarrier {
-        .srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe,
-        .srcAccessMask = {},
-        .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
-        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
-        .oldLayout = vk::ImageLayout::eUndefined,
-        .newLayout = vk::ImageLayout::eTransferDstOptimal,
-        .image = *image,
-        .subresourceRange = vk::ImageSubresourceRange {
-            .aspectMask = vk::ImageAspectFlagBits::eColor,
-            .baseMipLevel = 0,
-            .levelCount= 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
+            // staging memory is usually write combined, so the chain is filtered in regular memory first
+            std::vector<std::byte> mipChain(textureDataSize);
+            std::memcpy(mipChain.data(), textureData, static_cast<size_t>(width) * height * bytesPerPixel);
+            stbi_image_free(textureData);
+            generateMipChain(mipChain.data(), width, height, mipLevels);
+            std::memcpy(destination, mipChain.data(), textureDataSize);
+        }));
 
-    commandBuffer.pipelineBarrier2(vk::DependencyInfo {
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &initialImageMemoryBarrier,
-        });
+    return addLayer(format, bytesPerPixel, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, stagingChunkIndex, stagingOffset);
+}
 
-    commandBuffer.copyBufferToImage(*stagingBuffer, *image, vk::ImageLayout::eTransferDstOptimal, vk::BufferImageCopy {
-            .imageSubresource = vk::ImageSubresourceLayers {
-                .aspectMask = vk::ImageAspectFlagBits::eColor,
-                .mipLevel = 0,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-            .imageExtent = vk::Extent3D{ static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 },
+uint32_t TextureLoader::getMipLevels(const vk::Format format, const uint32_t width, const uint32_t height) const
+{
+    // the filter only knows 8 bit sRGB color with alpha
+    return generateMipmaps && format == vk::Format::eR8G8B8A8Srgb ? fullMipLevels(width, height) : 1;
+}
+
+uint32_t TextureLoader::addLayer(const vk::Format format, const uint32_t bytesPerPixel, const uint32_t width, const uint32_t height, const uint32_t mipLevels, const uint32_t stagingChunkIndex, const vk::DeviceSize stagingOffset)
+{
+    const uint32_t arrayIndex = getArrayIndex(format, bytesPerPixel, width, height, mipLevels);
+    const uint32_t layer = pendingArrays[arrayIndex].numLayers++;
+    const uint32_t slot = pendingArrays[arrayIndex].slot;
+    slotLayers[slot].set(layer);
+    pendingLayers.push_back(PendingLayer {
+            .arrayIndex = arrayIndex,
+            .layer = layer,
+            .stagingChunkIndex = stagingChunkIndex,
+            .stagingOffset = stagingOffset,
         });
 
-    const vk::ImageMemoryBarrier2 finalImageMemoryBarrier {
-        .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
-        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
-        .dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
-        .dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
-        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
-        .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-        .image = *image,
-        .subresourceRange = vk::ImageSubresourceRange {
-            .aspectMask = vk::ImageAspectFlagBits::eColor,
-            .baseMipLevel = 0,
-            .levelCount= 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-    };
+    return (slot << layerBits) | layer;
+}
 
-    commandBuffer.pipelineBarrier2(vk::DependencyInfo {
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &finalImageMemoryBarrier,
-        });
+void TextureLoader::unloadTexture(const uint32_t textureIndex)
+{
+    std::lock_guard lock(mutex);
+    const uint32_t slot = textureIndex >> layerBits;
+    const uint32_t layer = textureIndex & ((1u << layerBits) - 1);
+    if (slot >= slotLayers.size() || layer >= maxLayersPerArray || !slotLayers[slot].test(layer))
+    {
+        throw std::runtime_error("Unloading a texture that isn't loaded");
+    }
+    slotLayers[slot].reset(layer);
+    ++unloadCount;
+    if (slotLayers[slot].none())
+    {
+        // a slot may be unloaded, loaded into again and unloaded again before it is released, it's only queued once but
+        // waits for the last unload
+        const auto queued = std::find_if(unloadedSlots.begin(), unloadedSlots.end(), [&](const auto& unloaded) { return unloaded.second == slot; });
+        if (queued != unloadedSlots.end())
+        {
+            queued->first = unloadCount;
+        }
+        else
+        {
+            unloadedSlots.emplace_back(unloadCount, slot);
+        }
+    }
+}
+
+uint64_t TextureLoader::unloads()
+{
+    std::lock_guard lock(mutex);
+    return unloadCount;
+}
+
+bool TextureLoader::resident(const uint32_t textureIndex)
+{
+    // layers are only ever added to arrays that weren't committed yet, so any layer of a committed array is uploaded
+    std::lock_guard lock(mutex);
+    const uint32_t slot = textureIndex >> layerBits;
+    const uint32_t layer = textureIndex & ((1u << layerBits) - 1);
+    return slot < textures.size() && layer < maxLayersPerArray && slotLayers[slot].test(layer) && std::get<0>(textures[slot]);
+}
+
+uint32_t TextureLoader::getArrayIndex(const vk::Format format, const uint32_t bytesPerPixel, const uint32_t width, const uint32_t height, const uint32_t mipLevels)
+{
+    if (packingMode == PackingMode::ArrayLayers)
+    {
+        // textures already committed can't grow, so only arrays created since the last commit are candidates
+        for (uint32_t i = 0; i < pendingArrays.size(); ++i)
+        {
+            const auto& array = pendingArrays[i];
+            if (array.format == format && array.width == width && array.height == height && array.mipLevels == mipLevels && array.numLayers < maxLayersPerArray)
+            {
+                return i;
+            }
+        }
+    }
 
-    vk::raii::ImageView imageView(device, vk::ImageViewCreateInfo {
-            .image = *image,
-            .viewType = vk::ImageViewType::e2D,
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else if (slotLayers.size() < maxTextureArrays)
+    {
+        slot = slotLayers.size();
+        slotLayers.emplace_back();
+    }
+    else
+    {
+        throw std::runtime_error("Too many texture arrays");
+    }
+
+    pendingArrays.push_back(PendingArray {
+            .slot = slot,
             .format = format,
-            .subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 }
+            .bytesPerPixel = bytesPerPixel,
+            .width = width,
+            .height = height,
+            .mipLevels = mipLevels,
+            .numLayers = 0,
         });
+    return pendingArrays.size() - 1;
+}
+
+std::pair<uint32_t, vk::DeviceSize> TextureLoader::allocateStaging(const vk::DeviceSize size)
+{
+    const vk::DeviceSize alignedSize = (size + stagingAlignment - 1) & ~(stagingAlignment - 1);
+    if (stagingChunks.empty() || stagingChunks.back().used + alignedSize > stagingChunks.back().size)
+    {
+        const vk::DeviceSize chunkSize = std::max(stagingChunkSize, alignedSize);
+        vma::AllocationInfo allocationInfo;
+        auto [buffer, allocation] = allocator.createBufferUnique(vk::BufferCreateInfo {
+                .size = chunkSize,
+                .usage = vk::BufferUsageFlagBits::eTransferSrc,
+            }, vma::AllocationCreateInfo {
+                .flags = vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+                .usage = vma::MemoryUsage::eAuto,
+            }, allocationInfo);
+
+        stagingChunks.push_back(StagingChunk {
+                .buffer = std::move(buffer),
+                .allocation = std::move(allocation),
+                .mappedData = static_cast<std::byte*>(allocationInfo.pMappedData),
+                .size = chunkSize,
+                .used = 0,
+            });
+    }
 
-    return { std::move(image), std::move(allocation), std::move(imageView) };
+    auto& chunk = stagingChunks.back();
+    const vk::DeviceSize offset = chunk.used;
+    chunk.used += alignedSize;
+    return { static_cast<uint32_t>(stagingChunks.size() - 1), offset };
 }
 
-void TextureLoader::commit()
+std::vector<uint32_t> TextureLoader::commit()
 {
-    commandBuffer.end();
-    queue.submit(vk::SubmitInfo {
-            .commandBufferCount = 1,
-            .pCommandBuffers = &*commandBuffer,
-        }, fence);
+    std::lock_guard lock(mutex);
+    return commitPending();
 }
 
-void TextureLoader::finalize()
+std::vector<uint32_t> TextureLoader::update(const uint64_t drawnUnloads)
 {
-    if (auto result = device.waitForFences(*fence, vk::True, std::numeric_limits<uint64_t>::max()); result != vk::Result::eSuccess)
+    std::lock_guard lock(mutex);
+
+    std::erase_if(retiringSlots, [&](const auto& retiring)
+        {
+            if (!timeline.completed(retiring.first))
+            {
+                return false;
+            }
+            freeSlots.push_back(retiring.second);
+            return true;
+        });
+
+    std::vector<uint32_t> changedSlots;
+    // the upload command buffers are reused, a commit only happens once the previous one is done with them
+    if (!pendingLayers.empty() && timeline.completed(uploadValue) && std::all_of(decodeJobs.begin(), decodeJobs.end(), [](const auto& decodeJob) { return decodeJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }))
+    {
+        changedSlots = commitPending();
+    }
+
+    // slots of arrays that were unloaded before they were committed wait for the commit
+    std::erase_if(unloadedSlots, [&](const auto& unloaded)
+        {
+            const auto [unloadIndex, slot] = unloaded;
+            if (unloadIndex > drawnUnloads || slot >= textures.size() || !std::get<0>(textures[slot]))
+            {
+                return false;
+            }
+            // a layer may have been loaded into it again since, the array stays then
+            if (slotLayers[slot].none())
+            {
+                // the frame about to be recorded is the last one that may still sample it, its submission signals next
+                const uint64_t lastUse = timeline.lastSignaled() + 1;
+                timeline.retire(lastUse, std::move(textures[slot]));
+                retiringSlots.emplace_back(lastUse, slot);
+                changedSlots.push_back(slot);
+            }
+            return true;
+        });
+
+    return changedSlots;
+}
+
+std::vector<uint32_t> TextureLoader::commitPending()
+{
+    // rethrows the first decode failure
+    for (auto& decodeJob : decodeJobs)
+    {
+        decodeJob.get();
+    }
+    decodeJobs.clear();
+
+    for (const auto& chunk : stagingChunks)
+    {
+        allocator.flushAllocation(*chunk.allocation, 0, chunk.used);
+    }
+
+    if (pendingArrays.empty())
     {
-        throw std::runtime_error("Unexpected return from waitForFences");
+        return {};
     }
 
-    stagingBuffers.clear();
-    device.resetFences(*fence);
+    for (const auto& array : pendingArrays)
+    {
+        auto [image, allocation] = allocator.createImageUnique(vk::ImageCreateInfo {
+                .imageType = vk::ImageType::e2D,
+                .format = array.format,
+                .extent = vk::Extent3D{ array.width, array.height, 1 },
+                .mipLevels = array.mipLevels,
+                .arrayLayers = array.numLayers,
+                .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+                .initialLayout = vk::ImageLayout::eUndefined,
+            }, vma::AllocationCreateInfo {
+                .usage = vma::MemoryUsage::eAuto,
+            });
+
+        vk::raii::ImageView imageView(device, vk::ImageViewCreateInfo {
+                .image = *image,
+                .viewType = vk::ImageViewType::e2DArray,
+                .format = array.format,
+                .subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, array.mipLevels, 0, array.numLayers }
+            });
+
+        if (textures.size() <= array.slot)
+        {
+            textures.resize(array.slot + 1);
+        }
+        textures[array.slot] = { std::move(image), std::move(allocation), std::move(imageView) };
+    }
+
+    const bool ownershipTransfer = transferQueueFamilyIndex != queueFamilyIndex;
+    const auto& uploadCommandBuffer = ownershipTransfer ? transferCommandBuffer : commandBuffer;
+
+    // the command buffers are reused, so the previous upload has to be done with them
+    timeline.wait(uploadValue);
     commandPool.reset();
+    if (ownershipTransfer)
+    {
+        transferCommandPool.reset();
+    }
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo {
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        });
+    if (ownershipTransfer)
+    {
+        transferCommandBuffer.begin(vk::CommandBufferBeginInfo {
+                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+            });
+    }
+
+    std::vector<vk::ImageMemoryBarrier2> imageMemoryBarriers;
+    imageMemoryBarriers.reserve(pendingArrays.size());
+    for (const auto& array : pendingArrays)
+    {
+        imageMemoryBarriers.push_back(vk::ImageMemoryBarrier2 {
+                .srcStageMask = vk::PipelineStageFlagBits2::eTopOfPipe,
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .image = *std::get<0>(textures[array.slot]),
+                .subresourceRange = vk::ImageSubresourceRange {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount= array.mipLevels,
+                    .baseArrayLayer = 0,
+                    .layerCount = array.numLayers,
+                },
+            });
+    }
+
+    uploadCommandBuffer.pipelineBarrier2(vk::DependencyInfo {
+            .imageMemoryBarrierCount = static_cast<uint32_t>(imageMemoryBarriers.size()),
+            .pImageMemoryBarriers = imageMemoryBarriers.data(),
+        });
+
+    std::vector<vk::BufferImageCopy> copyRegions;
+    for (const auto& pendingLayer : pendingLayers)
+    {
+        const auto& array = pendingArrays[pendingLayer.arrayIndex];
+        copyRegions.clear();
+        vk::DeviceSize bufferOffset = pendingLayer.stagingOffset;
+        for (uint32_t level = 0; level < array.mipLevels; ++level)
+        {
+            const vk::Extent3D extent { std::max(array.width >> level, 1u), std::max(array.height >> level, 1u), 1 };
+            copyRegions.push_back(vk::BufferImageCopy {
+                    .bufferOffset = bufferOffset,
+                    .imageSubresource = vk::ImageSubresourceLayers {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = level,
+                        .baseArrayLayer = pendingLayer.layer,
+                        .layerCount = 1,
+                    },
+                    .imageExtent = extent,
+                });
+            bufferOffset += mipChainSize(extent.width, extent.height, 1, array.bytesPerPixel);
+        }
+        uploadCommandBuffer.copyBufferToImage(*stagingChunks[pendingLayer.stagingChunkIndex].buffer, *std::get<0>(textures[array.slot]), vk::ImageLayout::eTransferDstOptimal, copyRegions);
+    }
+    pendingLayers.clear();
+
+    for (auto& imageMemoryBarrier : imageMemoryBarriers)
+    {
+        imageMemoryBarrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+        imageMemoryBarrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+        imageMemoryBarrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+        imageMemoryBarrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+        imageMemoryBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        imageMemoryBarrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        if (ownershipTransfer)
+        {
+            imageMemoryBarrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+            imageMemoryBarrier.dstQueueFamilyIndex = queueFamilyIndex;
+        }
+    }
+
+    if (ownershipTransfer)
+    {
+        // release half of the ownership transfer, the destination scope is ignored on this queue
+        std::vector<vk::ImageMemoryBarrier2> releaseBarriers = imageMemoryBarriers;
+        for (auto& releaseBarrier : releaseBarriers)
+        {
+            releaseBarrier.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+            releaseBarrier.dstAccessMask = {};
+        }
+        transferCommandBuffer.pipelineBarrier2(vk::DependencyInfo {
+                .imageMemoryBarrierCount = static_cast<uint32_t>(releaseBarriers.size()),
+                .pImageMemoryBarriers = releaseBarriers.data(),
+            });
+
+        // acquire half, the source scope is covered by the semaphore wait
+        for (auto& imageMemoryBarrier : imageMemoryBarriers)
+        {
+            imageMemoryBarrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+            imageMemoryBarrier.srcAccessMask = {};
+        }
+    }
+
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo {
+            .imageMemoryBarrierCount = static_cast<uint32_t>(imageMemoryBarriers.size()),
+            .pImageMemoryBarriers = imageMemoryBarriers.data(),
+        });
+
+    commandBuffer.end();
+
+    const vk::CommandBufferSubmitInfo commandBufferSubmitInfo {
+        .commandBuffer = commandBuffer,
+    };
+
+    if (ownershipTransfer)
+    {
+        transferCommandBuffer.end();
+
+        const vk::CommandBufferSubmitInfo transferCommandBufferSubmitInfo {
+            .commandBuffer = transferCommandBuffer,
+        };
+
+        const vk::SemaphoreSubmitInfo signalSemaphoreInfo {
+            .semaphore = transferSemaphore,
+            .stageMask = vk::PipelineStageFlagBits2::eAllTransfer,
+        };
+
+        transferQueue.submit2(vk::SubmitInfo2 {
+                .commandBufferInfoCount = 1,
+                .pCommandBufferInfos = &transferCommandBufferSubmitInfo,
+                .signalSemaphoreInfoCount = 1,
+                .pSignalSemaphoreInfos = &signalSemaphoreInfo,
+            });
+
+        const vk::SemaphoreSubmitInfo waitSemaphoreInfo {
+            .semaphore = transferSemaphore,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+        };
+
+        const auto timelineSignalInfo = timeline.signal();
+        uploadValue = timelineSignalInfo.value;
+        queue.submit2(vk::SubmitInfo2 {
+                .waitSemaphoreInfoCount = 1,
+                .pWaitSemaphoreInfos = &waitSemaphoreInfo,
+                .commandBufferInfoCount = 1,
+                .pCommandBufferInfos = &commandBufferSubmitInfo,
+                .signalSemaphoreInfoCount = 1,
+                .pSignalSemaphoreInfos = &timelineSignalInfo,
+            });
+    }
+    else
+    {
+        const auto timelineSignalInfo = timeline.signal();
+        uploadValue = timelineSignalInfo.value;
+        queue.submit2(vk::SubmitInfo2 {
+                .commandBufferInfoCount = 1,
+                .pCommandBufferInfos = &commandBufferSubmitInfo,
+                .signalSemaphoreInfoCount = 1,
+                .pSignalSemaphoreInfos = &timelineSignalInfo,
+            });
+    }
+
+    // the staging memory goes once the GPU is past the upload, later loads get new chunks
+    timeline.retire(uploadValue, std::move(stagingChunks));
+    stagingChunks.clear();
+
+    // the queue runs the upload and its barriers before any frame submitted after it, so the slots are usable right away
+    std::vector<uint32_t> committedSlots;
+    for (const auto& array : pendingArrays)
+    {
+        committedSlots.push_back(array.slot);
+    }
+    pendingArrays.clear();
+    return committedSlots;
 }
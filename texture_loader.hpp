@@ -1,23 +1,136 @@
 #pragma  once
 
+#include "texture_pack.hpp"
 #include "vulkan_includes.hpp"
 
+#include <bitset>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
 namespace eng
 {
+    struct GpuTimeline;
+    struct ThreadPool;
+
     struct TextureLoader
     {
-        explicit TextureLoader(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vma::Allocator& allocator);
+        enum class PackingMode
+        {
+            // every texture gets its own single layer image
+            None,
+            // textures with the same size and format are packed into layers of one 2D array image
+            ArrayLayers,
+        };
+
+        // Texture indices returned by loadTexture hold the array image in the upper and the layer in the lower 16 bits.
+        static constexpr uint32_t layerBits = 16;
+        static constexpr uint32_t maxLayersPerArray = 256;
+
+        static constexpr vk::DeviceSize stagingChunkSize = 4 * 1024 * 1024;
+        static constexpr vk::DeviceSize stagingAlignment = 16;
+
+        // Uploads go through transferQueue, which may be the same queue as queue. With a separate family the images are
+        // handed over to queueFamilyIndex with a queue family ownership transfer. Array images go into maxTextureArrays
+        // slots, which are reused once the images in them are unloaded.
+        explicit TextureLoader(const vk::raii::Device& device, const vk::raii::Queue& queue, const uint32_t queueFamilyIndex, const vk::raii::Queue& transferQueue, const uint32_t transferQueueFamilyIndex, const vma::Allocator& allocator, ThreadPool& threadPool, GpuTimeline& timeline, const PackingMode packingMode, const bool generateMipmaps, const uint32_t maxTextureArrays);
+        ~TextureLoader();
+
+        // Textures found in the pack with a matching format are copied from it instead of decoding the file.
+        void openTexturePack(const std::string& filePath);
 
-        std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView> loadTexture(const std::string& filePath, const vk::Format format, const int channels, const int bytesPerPixel);
-        void commit();
-        void finalize();
+        // Only reads the file header, the pixels are decoded on the thread pool straight into staging memory.
+        // With generateMipmaps R8G8B8A8 sRGB textures get a full mip chain, computed on the thread pool too.
+        // The returned index can be drawn with once resident() says so. loadTexture, unloadTexture and resident may be
+        // called from any thread, the rest only from the render thread.
+        uint32_t loadTexture(const std::string& filePath, const vk::Format format, const int channels, const int bytesPerPixel);
+        // An array image is destroyed once all its layers are unloaded and the GPU is done with it. Throws for an index
+        // that isn't loaded, also one that was unloaded already.
+        void unloadTexture(const uint32_t textureIndex);
+        bool resident(const uint32_t textureIndex);
+        // Number of unloadTexture calls so far.
+        uint64_t unloads();
+
+        // Waits for the decode jobs and uploads everything loaded so far, returns the slots that got an image.
+        std::vector<uint32_t> commit();
+        // Once per frame, before recording it: uploads what finished decoding in the background and releases the images
+        // unloaded by the first drawnUnloads unloadTexture calls, which the frame must not draw anymore. Returns the
+        // slots whose image changed.
+        std::vector<uint32_t> update(const uint64_t drawnUnloads);
+
+        struct StagingChunk
+        {
+            vma::UniqueBuffer buffer;
+            vma::UniqueAllocation allocation;
+            std::byte* mappedData;
+            vk::DeviceSize size;
+            vk::DeviceSize used;
+        };
+
+        struct PendingLayer
+        {
+            // into pendingArrays
+            uint32_t arrayIndex;
+            uint32_t layer;
+            uint32_t stagingChunkIndex;
+            vk::DeviceSize stagingOffset;
+        };
+
+        struct PendingArray
+        {
+            uint32_t slot;
+            vk::Format format;
+            uint32_t bytesPerPixel;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;
+            uint32_t numLayers;
+        };
 
         const vk::raii::Device& device;
         const vk::raii::Queue& queue;
+        const vk::raii::Queue& transferQueue;
+        const uint32_t queueFamilyIndex;
+        const uint32_t transferQueueFamilyIndex;
         const vma::Allocator& allocator;
+        ThreadPool& threadPool;
+        GpuTimeline& timeline;
+        const PackingMode packingMode;
+        const bool generateMipmaps;
+        const uint32_t maxTextureArrays;
         const vk::raii::CommandPool commandPool;
         const vk::raii::CommandBuffer commandBuffer;
-        const vk::raii::Fence fence;
-        std::vector<std::pair<vma::UniqueBuffer, vma::UniqueAllocation>> stagingBuffers;
+        const vk::raii::CommandPool transferCommandPool;
+        const vk::raii::CommandBuffer transferCommandBuffer;
+        const vk::raii::Semaphore transferSemaphore;
+        // GpuTimeline value of the last commit
+        uint64_t uploadValue = 0;
+        std::optional<TexturePack> texturePack;
+        std::mutex mutex;
+        std::vector<StagingChunk> stagingChunks;
+        std::vector<std::future<void>> decodeJobs;
+        // arrays created since the last commit
+        std::vector<PendingArray> pendingArrays;
+        std::vector<PendingLayer> pendingLayers;
+        // by slot, only touched on the render thread, unused slots hold no image
+        std::vector<std::tuple<vma::UniqueImage, vma::UniqueAllocation, vk::raii::ImageView>> textures;
+        // by slot, layers loaded and not unloaded yet
+        std::vector<std::bitset<maxLayersPerArray>> slotLayers;
+        std::vector<uint32_t> freeSlots;
+        uint64_t unloadCount = 0;
+        // slots whose layers were all unloaded, with the unloadCount of their last unload, released by update once no
+        // frame draws them anymore
+        std::vector<std::pair<uint64_t, uint32_t>> unloadedSlots;
+        // slots free again once the timeline reaches the value
+        std::vector<std::pair<uint64_t, uint32_t>> retiringSlots;
+
+    private:
+        std::vector<uint32_t> commitPending();
+        uint32_t getMipLevels(const vk::Format format, const uint32_t width, const uint32_t height) const;
+        uint32_t getArrayIndex(const vk::Format format, const uint32_t bytesPerPixel, const uint32_t width, const uint32_t height, const uint32_t mipLevels);
+        std::pair<uint32_t, vk::DeviceSize> allocateStaging(const vk::DeviceSize size);
+        uint32_t addLayer(const vk::Format format, const uint32_t bytesPerPixel, const uint32_t width, const uint32_t height, const uint32_t mipLevels, const uint32_t stagingChunkIndex, const vk::DeviceSize stagingOffset);
     };
 }
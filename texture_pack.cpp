@@ -0,0 +1,50 @@
+#include "texture_pack.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using eng::TexturePack;
+namespace texture_pack = eng::texture_pack;
+
+TexturePack::TexturePack(const std::string& filePath) :
+    file(filePath),
+    mapping(file.data),
+    size(file.size)
+{
+    texture_pack::Header header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("Truncated texture pack: " + filePath);
+    }
+    std::memcpy(&header, mapping, sizeof(header));
+
+    const uint64_t entriesEnd = sizeof(header) + static_cast<uint64_t>(header.numEntries) * sizeof(texture_pack::Entry);
+    if (header.magic != texture_pack::magic || header.version != texture_pack::version || entriesEnd + header.stringTableSize > size)
+    {
+        throw std::runtime_error("Invalid texture pack: " + filePath);
+    }
+
+    const auto* packEntries = reinterpret_cast<const texture_pack::Entry*>(mapping + sizeof(header));
+    const auto* names = reinterpret_cast<const char*>(mapping + entriesEnd);
+    entries.reserve(header.numEntries);
+    for (uint32_t i = 0; i < header.numEntries; ++i)
+    {
+        const auto& entry = packEntries[i];
+        if (static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > header.stringTableSize || entry.dataOffset + entry.dataSize > size)
+        {
+            throw std::runtime_error("Invalid texture pack: " + filePath);
+        }
+        entries.emplace(std::string_view(names + entry.nameOffset, entry.nameLength), &entry);
+    }
+}
+
+const texture_pack::Entry* TexturePack::find(const std::string_view name) const
+{
+    auto it = entries.find(name);
+    return it != entries.end() ? it->second : nullptr;
+}
+
+const std::byte* TexturePack::data(const texture_pack::Entry& entry) const
+{
+    return mapping + entry.dataOffset;
+}
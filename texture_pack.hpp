@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace eng
+{
+    // File layout: Header, Entry[numEntries], name string table, then the pixel data of each entry at 16 byte aligned offsets.
+    // All offsets are from the start of the file. Pixel data is already in the entry's format and mip levels are stored
+    // back to back, largest first.
+    namespace texture_pack
+    {
+        constexpr uint32_t magic = 0x4B415054; // "TPAK"
+        constexpr uint32_t version = 1;
+        constexpr uint64_t dataAlignment = 16;
+
+        // VK_FORMAT_R8G8B8A8_SRGB, spelled out so the pack tool doesn't need the Vulkan headers
+        constexpr uint32_t formatR8G8B8A8Srgb = 43;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t numEntries;
+            uint32_t stringTableSize;
+        };
+
+        struct Entry
+        {
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            uint32_t width;
+            uint32_t height;
+            uint32_t format;
+            uint32_t mipLevels;
+            uint64_t dataOffset;
+            uint64_t dataSize;
+        };
+
+        static_assert(sizeof(Header) == 16);
+        static_assert(sizeof(Entry) == 40);
+    }
+
+    // Read only memory mapping of a texture pack with a lookup by name.
+    struct TexturePack
+    {
+        explicit TexturePack(const std::string& filePath);
+
+        TexturePack(const TexturePack&) = delete;
+        TexturePack& operator=(const TexturePack&) = delete;
+
+        const texture_pack::Entry* find(const std::string_view name) const;
+        const std::byte* data(const texture_pack::Entry& entry) const;
+
+        const MappedFile file;
+        const std::byte* const mapping;
+        const size_t size;
+        std::unordered_map<std::string_view, const texture_pack::Entry*> entries;
+    };
+}
@@ -0,0 +1,57 @@
+#include "thread_pool.hpp"
+
+using eng::ThreadPool;
+
+ThreadPool::ThreadPool(const uint32_t numThreads)
+{
+    threads.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()>&& job)
+{
+    std::packaged_task<void()> task(std::move(job));
+    auto future = task.get_future();
+    {
+        std::lock_guard lock(mutex);
+        jobs.push_back(std::move(task));
+    }
+    condition.notify_one();
+    return future;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+            // remaining jobs are still run so nobody waits on a future that never resolves
+            if (jobs.empty())
+            {
+                return;
+            }
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eng
+{
+    struct ThreadPool
+    {
+        explicit ThreadPool(const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 1u));
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Exceptions thrown by the job are rethrown from the returned future's get().
+        std::future<void> submit(std::function<void()>&& job);
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::packaged_task<void()>> jobs;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+
+    private:
+        void workerLoop();
+    };
+}